@@ -0,0 +1,229 @@
+// Source file for convolutions of float planes
+
+
+
+// Include files
+
+#include "R2/R2.h"
+#include "R2Convolve.h"
+#include "R2Parallel.h"
+#include <algorithm>
+#include <vector>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Borders
+////////////////////////////////////////////////////////////////////////
+
+// Returns the index inside 0 <= i < n that index i stands for, or -1 for a 0
+//    value outside the plane; mirrored indices are reflected back and forth
+//    for kernels wider than the plane
+static inline int
+BorderIndex(int i, int n, int border)
+{
+  if ((i >= 0) && (i < n)) return i;
+  if (border == R2_CONVOLVE_ZERO_BORDER) return -1;
+  if ((border == R2_CONVOLVE_CLAMP_BORDER) || (n == 1)) return (i < 0) ? 0 : n - 1;
+  int period = 2 * (n - 1);
+  i %= period;
+  if (i < 0) i += period;
+  return (i < n) ? i : period - i;
+}
+
+
+
+// Returns the column that column x stands for (zeros outside the plane with
+//    a zero border)
+static inline const float *
+BorderColumn(const float *plane, int x, int width, int height, int border, const float *zeros)
+{
+  int i = BorderIndex(x, width, border);
+  return (i < 0) ? zeros : plane + (size_t) i * height;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Sums of taps
+////////////////////////////////////////////////////////////////////////
+
+// Sets dst[j] (or adds to it, with accumulate) the sum of kernel[t] * src[t][j]
+//    over the TAPS taps, for 0 <= j < n.  The taps are unrolled and the loop
+//    over j runs along contiguous pixels, so it vectorizes
+template <int TAPS>
+static inline void
+SumFixedTaps(const float *const *src, const float *kernel, int n, float *dst, int accumulate)
+{
+  const float *s[TAPS];
+  float k[TAPS];
+  for (int t = 0; t < TAPS; t++) {
+    s[t] = src[t];
+    k[t] = kernel[t];
+  }
+  if (accumulate) {
+    for (int j = 0; j < n; j++) {
+      float sum = dst[j];
+      for (int t = 0; t < TAPS; t++) sum += k[t] * s[t][j];
+      dst[j] = sum;
+    }
+  }
+  else {
+    for (int j = 0; j < n; j++) {
+      float sum = k[0] * s[0][j];
+      for (int t = 1; t < TAPS; t++) sum += k[t] * s[t][j];
+      dst[j] = sum;
+    }
+  }
+}
+
+
+
+// Sums any number of taps: 3, 5 and 7 taps in one sweep over dst, others
+//    4 at a time
+static void
+SumTaps(const float *const *src, const float *kernel, int ntaps, int n, float *dst, int accumulate)
+{
+  switch (ntaps) {
+  case 3: SumFixedTaps<3>(src, kernel, n, dst, accumulate); return;
+  case 5: SumFixedTaps<5>(src, kernel, n, dst, accumulate); return;
+  case 7: SumFixedTaps<7>(src, kernel, n, dst, accumulate); return;
+  }
+
+  for (int t = 0; t < ntaps; t += 4) {
+    int add = (accumulate || (t > 0)) ? 1 : 0;
+    switch (std::min(ntaps - t, 4)) {
+    case 4: SumFixedTaps<4>(src + t, kernel + t, n, dst, add); break;
+    case 3: SumFixedTaps<3>(src + t, kernel + t, n, dst, add); break;
+    case 2: SumFixedTaps<2>(src + t, kernel + t, n, dst, add); break;
+    case 1: SumFixedTaps<1>(src + t, kernel + t, n, dst, add); break;
+    }
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Separable convolution
+////////////////////////////////////////////////////////////////////////
+
+// Number of floats of source columns that one column tile should touch, so
+// they are still in cache when the next column reuses them
+#define CONVOLVE_TILE_FLOATS 32768
+#define CONVOLVE_MIN_TILE_HEIGHT 64
+
+
+
+void
+R2ConvolveSeparable(const float *plane, int width, int height, const float *xkernel, int xsize,
+  const float *ykernel, int ysize, float *filtered, int border, int accumulate)
+{
+  assert((xsize % 2 == 1) && (ysize % 2 == 1));
+  int xradius = xsize / 2, yradius = ysize / 2;
+  if ((width <= 0) || (height <= 0)) return;
+
+  // Columns are filtered from their neighbors, so filter from a copy in place
+  std::vector<float> copy;
+  if (filtered == plane) {
+    copy.assign(plane, plane + (size_t) width * height);
+    plane = copy.data();
+  }
+  const std::vector<float> zeros((border == R2_CONVOLVE_ZERO_BORDER) ? height : 0, 0.0f);
+
+  // Both passes are done together, one column tile at a time: the tile is
+  // first filtered across columns into a buffer (with yradius extra pixels at
+  // both ends), then along the column from the buffer.  Tiles are short
+  // enough for the source columns to stay in cache from one column to the next
+  int tile = std::max(CONVOLVE_MIN_TILE_HEIGHT, CONVOLVE_TILE_FLOATS / xsize);
+  if (tile > height) tile = height;
+  int ntiles = (height + tile - 1) / tile;
+
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    std::vector<float> buffer(tile + 2 * yradius);
+    std::vector<const float *> columns(xsize), rows(ysize);
+    for (int t = 0; t < ntiles; t++) {
+      int y0 = t * tile, y1 = std::min(height, y0 + tile);
+      int b0 = std::max(0, y0 - yradius), b1 = std::min(height, y1 + yradius);
+      int base = y0 - yradius;
+      float *row = buffer.data();
+      for (int x = begin; x < end; x++) {
+        // Filter across columns, for the rows of the tile and its margins
+        // inside the plane
+        for (int i = 0; i < xsize; i++) {
+          columns[i] = BorderColumn(plane, x + i - xradius, width, height, border, zeros.data()) + b0;
+        }
+        SumTaps(columns.data(), xkernel, xsize, b1 - b0, row + (b0 - base), 0);
+
+        // Fill the margins outside the plane from the rows inside
+        for (int j = base; j < y1 + yradius; j++) {
+          if (j == b0) j = b1;
+          if (j >= y1 + yradius) break;
+          int k = BorderIndex(j, height, border);
+          row[j - base] = (k < 0) ? 0.0f : row[k - base];
+        }
+
+        // Filter along the column
+        for (int i = 0; i < ysize; i++) rows[i] = row + i;
+        SumTaps(rows.data(), ykernel, ysize, y1 - y0, filtered + (size_t) x * height + y0, accumulate);
+      }
+    }
+  });
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// General convolution
+////////////////////////////////////////////////////////////////////////
+
+void
+R2Convolve(const float *plane, int width, int height, const float *kernel, int xsize, int ysize,
+  float *filtered, int border, int accumulate)
+{
+  assert((xsize % 2 == 1) && (ysize % 2 == 1));
+  int xradius = xsize / 2, yradius = ysize / 2;
+  if ((width <= 0) || (height <= 0)) return;
+
+  // Filter from a copy in place
+  std::vector<float> copy;
+  if (filtered == plane) {
+    copy.assign(plane, plane + (size_t) width * height);
+    plane = copy.data();
+  }
+  const std::vector<float> zeros((border == R2_CONVOLVE_ZERO_BORDER) ? height : 0, 0.0f);
+
+  // Rows whose neighborhoods are inside the plane are filtered one kernel
+  // column at a time, as a sum of taps along the source column; the few
+  // rows near the bottom and top are filtered pixel by pixel
+  int inner0 = std::min(yradius, height), inner1 = std::max(inner0, height - yradius);
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    std::vector<const float *> columns(xsize), rows(ysize);
+    for (int x = begin; x < end; x++) {
+      float *dst = filtered + (size_t) x * height;
+      for (int i = 0; i < xsize; i++) {
+        columns[i] = BorderColumn(plane, x + i - xradius, width, height, border, zeros.data());
+      }
+
+      // Inner rows
+      if (inner1 > inner0) {
+        for (int i = 0; i < xsize; i++) {
+          for (int j = 0; j < ysize; j++) rows[j] = columns[i] + inner0 + j - yradius;
+          SumTaps(rows.data(), kernel + i * ysize, ysize, inner1 - inner0, dst + inner0, (accumulate || (i > 0)) ? 1 : 0);
+        }
+      }
+
+      // Rows near the bottom and top
+      for (int y = 0; y < height; y++) {
+        if (y == inner0) y = inner1;
+        if (y == height) break;
+        float sum = 0;
+        for (int j = 0; j < ysize; j++) {
+          int k = BorderIndex(y + j - yradius, height, border);
+          if (k < 0) continue;
+          for (int i = 0; i < xsize; i++) sum += kernel[i * ysize + j] * columns[i][k];
+        }
+        dst[y] = (accumulate) ? dst[y] + sum : sum;
+      }
+    }
+  });
+}
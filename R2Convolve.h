@@ -0,0 +1,37 @@
+// Include file for convolutions of float planes
+#ifndef R2_CONVOLVE_INCLUDED
+#define R2_CONVOLVE_INCLUDED
+
+
+
+// Constant definitions
+
+typedef enum {
+  R2_CONVOLVE_CLAMP_BORDER,
+  R2_CONVOLVE_MIRROR_BORDER,
+  R2_CONVOLVE_ZERO_BORDER,
+  R2_CONVOLVE_NUM_BORDER_MODES
+} R2ConvolveBorderMode;
+
+
+
+// Function declarations
+
+// Filters a width by height plane laid out like image pixels, plane[x*height + y],
+// with an xsize by ysize kernel of odd sizes, centered on each pixel:
+// filtered(x, y) is the sum of kernel[i*ysize + j] * plane(x + i - xsize/2, y + j - ysize/2)
+// (kernels are laid out like planes, and read as they are written, not flipped).
+// Pixels outside the plane repeat the border pixels (clamp), mirror the plane
+// about its border pixels, or are 0, depending on the border mode.  The result
+// is added to filtered if accumulate is set.  plane and filtered may be the same
+void R2Convolve(const float *plane, int width, int height, const float *kernel, int xsize, int ysize,
+  float *filtered, int border = R2_CONVOLVE_CLAMP_BORDER, int accumulate = 0);
+
+// Filters a plane as above with the separable kernel xkernel[i] * ykernel[j],
+// with xsize + ysize operations per pixel instead of xsize * ysize
+void R2ConvolveSeparable(const float *plane, int width, int height, const float *xkernel, int xsize,
+  const float *ykernel, int ysize, float *filtered, int border = R2_CONVOLVE_CLAMP_BORDER, int accumulate = 0);
+
+
+
+#endif
@@ -0,0 +1,442 @@
+// Source file for the FFT class and phase correlation
+
+
+
+// Include files
+
+#include "R2/R2.h"
+#include "R2FFT.h"
+#include "R2Parallel.h"
+#include <algorithm>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Complex arithmetic
+////////////////////////////////////////////////////////////////////////
+
+// M_PI is not defined by every compiler
+#define FFT_PI 3.14159265358979323846
+
+// std::complex multiplication checks for infinities and NaNs (calling a library
+// function unless compiled with -ffast-math), so the inner loops use these instead
+
+static inline R2Complex
+Mul(const R2Complex& a, const R2Complex& b)
+{
+  return R2Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+
+
+static inline R2Complex
+MulConj(const R2Complex& a, const R2Complex& b)
+{
+  // Return conj(a) * b
+  return R2Complex(a.real() * b.real() + a.imag() * b.imag(), a.real() * b.imag() - a.imag() * b.real());
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Butterflies
+////////////////////////////////////////////////////////////////////////
+
+// Each butterfly combines p interleaved transforms of size m, stored one after
+// the other in out, into one transform of size p*m; stride is the step through
+// the twiddle table of the full transform
+
+static void
+Butterfly2(R2Complex *out, int stride, int m, const R2Complex *twiddles)
+{
+  R2Complex *out1 = out + m;
+  for (int k = 0; k < m; k++) {
+    R2Complex t = Mul(out1[k], twiddles[k * stride]);
+    out1[k] = out[k] - t;
+    out[k] += t;
+  }
+}
+
+
+
+static void
+Butterfly3(R2Complex *out, int stride, int m, const R2Complex *twiddles)
+{
+  const float epi3 = twiddles[stride * m].imag();
+  R2Complex *out1 = out + m, *out2 = out + 2*m;
+  for (int k = 0; k < m; k++) {
+    R2Complex s1 = Mul(out1[k], twiddles[k * stride]);
+    R2Complex s2 = Mul(out2[k], twiddles[2 * k * stride]);
+    R2Complex s3 = s1 + s2;
+    R2Complex s0 = (s1 - s2) * epi3;
+    R2Complex a = out[k] - s3 * 0.5f;
+    out[k] += s3;
+    out2[k] = R2Complex(a.real() + s0.imag(), a.imag() - s0.real());
+    out1[k] = R2Complex(a.real() - s0.imag(), a.imag() + s0.real());
+  }
+}
+
+
+
+static void
+Butterfly4(R2Complex *out, int stride, int m, const R2Complex *twiddles, int inverse)
+{
+  R2Complex *out1 = out + m, *out2 = out + 2*m, *out3 = out + 3*m;
+  for (int k = 0; k < m; k++) {
+    R2Complex s0 = Mul(out1[k], twiddles[k * stride]);
+    R2Complex s1 = Mul(out2[k], twiddles[2 * k * stride]);
+    R2Complex s2 = Mul(out3[k], twiddles[3 * k * stride]);
+    R2Complex s5 = out[k] - s1;
+    R2Complex a = out[k] + s1;
+    R2Complex s3 = s0 + s2, s4 = s0 - s2;
+    out2[k] = a - s3;
+    out[k] = a + s3;
+    if (inverse) {
+      out1[k] = R2Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+      out3[k] = R2Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+    }
+    else {
+      out1[k] = R2Complex(s5.real() + s4.imag(), s5.imag() - s4.real());
+      out3[k] = R2Complex(s5.real() - s4.imag(), s5.imag() + s4.real());
+    }
+  }
+}
+
+
+
+static void
+Butterfly5(R2Complex *out, int stride, int m, const R2Complex *twiddles)
+{
+  const R2Complex ya = twiddles[stride * m], yb = twiddles[2 * stride * m];
+  R2Complex *out1 = out + m, *out2 = out + 2*m, *out3 = out + 3*m, *out4 = out + 4*m;
+  for (int k = 0; k < m; k++) {
+    R2Complex s0 = out[k];
+    R2Complex s1 = Mul(out1[k], twiddles[k * stride]);
+    R2Complex s2 = Mul(out2[k], twiddles[2 * k * stride]);
+    R2Complex s3 = Mul(out3[k], twiddles[3 * k * stride]);
+    R2Complex s4 = Mul(out4[k], twiddles[4 * k * stride]);
+    R2Complex s7 = s1 + s4, s10 = s1 - s4, s8 = s2 + s3, s9 = s2 - s3;
+    out[k] = s0 + s7 + s8;
+    R2Complex s5(s0.real() + s7.real() * ya.real() + s8.real() * yb.real(),
+                 s0.imag() + s7.imag() * ya.real() + s8.imag() * yb.real());
+    R2Complex s6(s10.imag() * ya.imag() + s9.imag() * yb.imag(),
+                 -s10.real() * ya.imag() - s9.real() * yb.imag());
+    out1[k] = s5 - s6;
+    out4[k] = s5 + s6;
+    R2Complex s11(s0.real() + s7.real() * yb.real() + s8.real() * ya.real(),
+                  s0.imag() + s7.imag() * yb.real() + s8.imag() * ya.real());
+    R2Complex s12(-s10.imag() * yb.imag() + s9.imag() * ya.imag(),
+                  s10.real() * yb.imag() - s9.real() * ya.imag());
+    out2[k] = s11 + s12;
+    out3[k] = s11 - s12;
+  }
+}
+
+
+
+static void
+ButterflyGeneric(R2Complex *out, int stride, int m, int p, int n, const R2Complex *twiddles)
+{
+  std::vector<R2Complex> scratch(p);
+  for (int u = 0; u < m; u++) {
+    for (int q = 0, k = u; q < p; q++, k += m) scratch[q] = out[k];
+    for (int q1 = 0, k = u; q1 < p; q1++, k += m) {
+      int index = 0;
+      R2Complex sum = scratch[0];
+      for (int q = 1; q < p; q++) {
+        index += stride * k;
+        if (index >= n) index -= n;
+        sum += Mul(scratch[q], twiddles[index]);
+      }
+      out[k] = sum;
+    }
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constructors
+////////////////////////////////////////////////////////////////////////
+
+R2FFT::
+R2FFT(int n)
+  : n(n)
+{
+  // Factor n into radices (4 first, then 2, 3, 5 and any remaining primes),
+  // storing each radix and the size of the transforms it combines
+  int remaining = n, p = 4;
+  while (remaining > 1) {
+    while (remaining % p) {
+      switch (p) {
+      case 4: p = 2; break;
+      case 2: p = 3; break;
+      default: p += 2; break;
+      }
+      if (p * p > remaining) p = remaining;
+    }
+    remaining /= p;
+    factors.push_back(p);
+    factors.push_back(remaining);
+  }
+
+  // Precompute the twiddle factors exp(-+2 pi i k / n)
+  forward_twiddles.resize(n);
+  inverse_twiddles.resize(n);
+  for (int k = 0; k < n; k++) {
+    double angle = -2.0 * FFT_PI * k / n;
+    forward_twiddles[k] = R2Complex((float) cos(angle), (float) sin(angle));
+    inverse_twiddles[k] = std::conj(forward_twiddles[k]);
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Transforms
+////////////////////////////////////////////////////////////////////////
+
+void R2FFT::
+Transform(R2Complex *output, const R2Complex *input, int stride, int stage,
+  const R2Complex *twiddles, int inverse) const
+{
+  // Recursively transform the p subsequences of every p-th input value, and
+  // store them one after the other in output
+  int p = factors[2*stage], m = factors[2*stage + 1];
+  if (m == 1) {
+    for (int q = 0; q < p; q++, input += stride) output[q] = *input;
+  }
+  else {
+    for (int q = 0; q < p; q++, input += stride) {
+      Transform(output + q*m, input, stride * p, stage + 1, twiddles, inverse);
+    }
+  }
+
+  // Combine them
+  switch (p) {
+  case 2: Butterfly2(output, stride, m, twiddles); break;
+  case 3: Butterfly3(output, stride, m, twiddles); break;
+  case 4: Butterfly4(output, stride, m, twiddles, inverse); break;
+  case 5: Butterfly5(output, stride, m, twiddles); break;
+  default: ButterflyGeneric(output, stride, m, p, n, twiddles); break;
+  }
+}
+
+
+
+void R2FFT::
+Forward(const R2Complex *input, R2Complex *output) const
+{
+  // Compute the transform
+  if (n <= 1) { if (n == 1) output[0] = input[0]; return; }
+  Transform(output, input, 1, 0, forward_twiddles.data(), 0);
+}
+
+
+
+void R2FFT::
+Inverse(const R2Complex *input, R2Complex *output) const
+{
+  // Compute the (unscaled) inverse transform
+  if (n <= 1) { if (n == 1) output[0] = input[0]; return; }
+  Transform(output, input, 1, 0, inverse_twiddles.data(), 1);
+}
+
+
+
+int
+R2FFTSize(int n)
+{
+  // Return smallest 5-smooth number >= n
+  for (int size = std::max(n, 1); ; size++) {
+    int m = size;
+    while (m % 2 == 0) m /= 2;
+    while (m % 3 == 0) m /= 3;
+    while (m % 5 == 0) m /= 5;
+    if (m == 1) return size;
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// 2D transforms of real planes
+////////////////////////////////////////////////////////////////////////
+
+void
+R2RealFFT2D(const float *plane, int nx, int ny, std::vector<R2Complex>& spectrum)
+{
+  const int half = ny / 2 + 1;
+  spectrum.resize((size_t) half * nx);
+
+  // Transform the rows two at a time, as the real and imaginary parts of one
+  // complex row, and separate their spectra using their symmetry.  The spectra
+  // are stored transposed: consecutive pairs write next to each other, so the
+  // cache lines written by a band are filled before they are evicted
+  R2FFT fft_y(ny);
+  R2ParallelFor(0, (nx + 1) / 2, R2NumThreads(), [&](int begin, int end) {
+    std::vector<R2Complex> z(ny), Z(ny);
+    for (int pair = begin; pair < end; pair++) {
+      int x0 = 2 * pair, x1 = x0 + 1;
+      const float *p0 = plane + (size_t) x0 * ny;
+      const float *p1 = (x1 < nx) ? plane + (size_t) x1 * ny : NULL;
+      if (p1) for (int y = 0; y < ny; y++) z[y] = R2Complex(p0[y], p1[y]);
+      else for (int y = 0; y < ny; y++) z[y] = R2Complex(p0[y], 0.0f);
+      fft_y.Forward(z.data(), Z.data());
+      R2Complex *column = &spectrum[x0];
+      for (int k = 0; k < half; k++) {
+        R2Complex a = Z[k], b = std::conj(Z[(k == 0) ? 0 : ny - k]);
+        column[(size_t) k * nx] = 0.5f * (a + b);
+        if (p1) { R2Complex d = a - b; column[(size_t) k * nx + 1] = R2Complex(0.5f * d.imag(), -0.5f * d.real()); }
+      }
+    }
+  });
+
+  // Transform the columns, which are now contiguous
+  R2FFT fft_x(nx);
+  R2ParallelFor(0, half, R2NumThreads(), [&](int begin, int end) {
+    std::vector<R2Complex> column(nx);
+    for (int k = begin; k < end; k++) {
+      R2Complex *row = &spectrum[(size_t) k * nx];
+      std::copy(row, row + nx, column.begin());
+      fft_x.Forward(column.data(), row);
+    }
+  });
+}
+
+
+
+void
+R2InverseRealFFT2D(const std::vector<R2Complex>& spectrum, int nx, int ny, float *plane)
+{
+  const int half = ny / 2 + 1;
+  std::vector<R2Complex> columns((size_t) half * nx);
+
+  // Inverse transform the columns
+  R2FFT fft_x(nx);
+  R2ParallelFor(0, half, R2NumThreads(), [&](int begin, int end) {
+    for (int k = begin; k < end; k++) {
+      fft_x.Inverse(&spectrum[(size_t) k * nx], &columns[(size_t) k * nx]);
+    }
+  });
+
+  // Inverse transform the rows two at a time: each row spectrum is completed
+  // by symmetry, and the second one is put in the imaginary part
+  const float scale = 1.0f / ((float) nx * ny);
+  R2FFT fft_y(ny);
+  R2ParallelFor(0, (nx + 1) / 2, R2NumThreads(), [&](int begin, int end) {
+    std::vector<R2Complex> z(ny), Z(ny);
+    for (int pair = begin; pair < end; pair++) {
+      int x0 = 2 * pair, x1 = x0 + 1;
+      const R2Complex *column = &columns[x0];
+      if (x1 < nx) {
+        for (int k = 0; k < half; k++) {
+          R2Complex a = column[(size_t) k * nx], b = column[(size_t) k * nx + 1];
+          Z[k] = R2Complex(a.real() - b.imag(), a.imag() + b.real());
+          if ((k > 0) && (ny - k >= half)) Z[ny - k] = R2Complex(a.real() + b.imag(), b.real() - a.imag());
+        }
+      }
+      else {
+        for (int k = 0; k < half; k++) {
+          Z[k] = column[(size_t) k * nx];
+          if ((k > 0) && (ny - k >= half)) Z[ny - k] = std::conj(Z[k]);
+        }
+      }
+      fft_y.Inverse(Z.data(), z.data());
+      float *p0 = plane + (size_t) x0 * ny;
+      for (int y = 0; y < ny; y++) p0[y] = z[y].real() * scale;
+      if (x1 < nx) {
+        float *p1 = plane + (size_t) x1 * ny;
+        for (int y = 0; y < ny; y++) p1[y] = z[y].imag() * scale;
+      }
+    }
+  });
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Phase correlation
+////////////////////////////////////////////////////////////////////////
+
+// Copies a luminance plane into the top left corner of a zero nx by ny plane,
+// without its mean and tapered to zero at its borders (Hann window), so the
+// borders of the image do not correlate with each other
+static void
+PreparePlane(const float *luminance, int width, int height, int nx, int ny, std::vector<float>& padded)
+{
+  double mean = 0;
+  for (size_t i = 0; i < (size_t) width * height; i++) mean += luminance[i];
+  mean /= (double) width * height;
+
+  std::vector<float> wy(height);
+  for (int y = 0; y < height; y++) wy[y] = (float) (0.5 - 0.5 * cos(2.0 * FFT_PI * (y + 0.5) / height));
+
+  padded.assign((size_t) nx * ny, 0.0f);
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    for (int x = begin; x < end; x++) {
+      float wx = (float) (0.5 - 0.5 * cos(2.0 * FFT_PI * (x + 0.5) / width));
+      const float *src = luminance + (size_t) x * height;
+      float *dst = &padded[(size_t) x * ny];
+      for (int y = 0; y < height; y++) dst[y] = (src[y] - (float) mean) * wx * wy[y];
+    }
+  });
+}
+
+
+
+// Returns the offset of the vertex of the parabola through (-1, l), (0, c), (1, r)
+static double
+ParabolaPeak(double l, double c, double r)
+{
+  double denominator = l - 2.0 * c + r;
+  if (denominator >= 0) return 0.0;
+  double offset = 0.5 * (l - r) / denominator;
+  return std::min(std::max(offset, -0.5), 0.5);
+}
+
+
+
+double
+R2PhaseCorrelate(const float *luminance1, int width1, int height1,
+  const float *luminance2, int width2, int height2, double& dx, double& dy)
+{
+  // Transform both planes, padded to a common fast size
+  int nx = R2FFTSize(std::max(width1, width2)), ny = R2FFTSize(std::max(height1, height2));
+  std::vector<float> plane1, plane2;
+  PreparePlane(luminance1, width1, height1, nx, ny, plane1);
+  PreparePlane(luminance2, width2, height2, nx, ny, plane2);
+  std::vector<R2Complex> spectrum1, spectrum2;
+  R2RealFFT2D(plane1.data(), nx, ny, spectrum1);
+  R2RealFFT2D(plane2.data(), nx, ny, spectrum2);
+
+  // Keep only the phase of the cross power spectrum
+  R2ParallelFor(0, (int) spectrum1.size(), R2NumThreads(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      R2Complex c = MulConj(spectrum1[i], spectrum2[i]);
+      float magnitude = sqrtf(c.real() * c.real() + c.imag() * c.imag());
+      spectrum1[i] = (magnitude > 1e-20f) ? c / magnitude : R2Complex(0, 0);
+    }
+  });
+
+  // Transform back: a shift by (dx, dy) gives a peak at (dx, dy) (modulo the size)
+  std::vector<float>& correlation = plane1;
+  R2InverseRealFFT2D(spectrum1, nx, ny, correlation.data());
+  size_t best = 0;
+  for (size_t i = 1; i < correlation.size(); i++) {
+    if (correlation[i] > correlation[best]) best = i;
+  }
+  int px = (int) (best / ny), py = (int) (best % ny);
+
+  // Interpolate the peak position along both axes
+  double c = correlation[best];
+  double l = correlation[(size_t) ((px + nx - 1) % nx) * ny + py], r = correlation[(size_t) ((px + 1) % nx) * ny + py];
+  double u = correlation[(size_t) px * ny + (py + ny - 1) % ny], d = correlation[(size_t) px * ny + (py + 1) % ny];
+  dx = px + ParabolaPeak(l, c, r);
+  dy = py + ParabolaPeak(u, c, d);
+  if (dx > nx / 2) dx -= nx;
+  if (dy > ny / 2) dy -= ny;
+
+  // Return peak height
+  return c;
+}
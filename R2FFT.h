@@ -0,0 +1,82 @@
+// Include file for the FFT class and phase correlation
+#ifndef R2_FFT_INCLUDED
+#define R2_FFT_INCLUDED
+
+
+
+// Include files
+
+#include <complex>
+#include <vector>
+
+
+
+// Type definitions
+
+typedef std::complex<float> R2Complex;
+
+
+
+// Class definition
+
+class R2FFT {
+ public:
+  // Constructor (any size works, sizes with no prime factors but 2, 3 and 5 are fastest)
+  R2FFT(int n);
+
+  // Property functions
+  int Size(void) const;
+
+  // Transforms n values from input to output (which must not overlap);
+  // the inverse transform is not scaled by 1/n
+  void Forward(const R2Complex *input, R2Complex *output) const;
+  void Inverse(const R2Complex *input, R2Complex *output) const;
+
+ private:
+  void Transform(R2Complex *output, const R2Complex *input, int stride, int stage,
+    const R2Complex *twiddles, int inverse) const;
+
+ private:
+  int n;
+  std::vector<int> factors;
+  std::vector<R2Complex> forward_twiddles;
+  std::vector<R2Complex> inverse_twiddles;
+};
+
+
+
+// Function declarations
+
+// Returns the smallest size >= n with no prime factors but 2, 3 and 5
+int R2FFTSize(int n);
+
+// Computes the 2D FFT of a real nx by ny plane laid out like image pixels
+// (plane[x*ny + y]).  As the spectrum of a real plane is symmetric, only the
+// (ny/2 + 1) by nx half with non-negative y frequencies is stored, transposed:
+// spectrum[ky*nx + kx]
+void R2RealFFT2D(const float *plane, int nx, int ny, std::vector<R2Complex>& spectrum);
+
+// Inverse of R2RealFFT2D, scaled so that it recovers the original plane
+void R2InverseRealFFT2D(const std::vector<R2Complex>& spectrum, int nx, int ny, float *plane);
+
+// Estimates the translation (dx, dy) such that point (x, y) of the first
+// luminance plane corresponds to (x + dx, y + dy) in the second one, by phase
+// correlation with sub-pixel peak interpolation; returns the height of the
+// correlation peak (between 0 and 1, larger is more reliable)
+double R2PhaseCorrelate(const float *luminance1, int width1, int height1,
+  const float *luminance2, int width2, int height2, double& dx, double& dy);
+
+
+
+// Inline functions
+
+inline int R2FFT::
+Size(void) const
+{
+  // Return number of values transformed
+  return n;
+}
+
+
+
+#endif
@@ -0,0 +1,570 @@
+// Source file for feature detection
+
+
+
+// Include files 
+
+#include "R2/R2.h"
+#include "R2Pixel.h"
+#include "R2Image.h"
+#include "R2Feature.h"
+#include "R2Filter.h"
+#include "R2Parallel.h"
+#include <algorithm>
+#include <climits>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Luminance
+////////////////////////////////////////////////////////////////////////
+
+void 
+R2ComputeLuminance(const R2Image& image, std::vector<float>& luminance)
+{
+  int width = image.Width(), height = image.Height();
+  luminance.resize((size_t) width * height);
+
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      const R2Pixel *src = image[i];
+      float *dst = &luminance[(size_t) i * height];
+      for (int j = 0; j < height; j++) {
+        dst[j] = (float) src[j].Luminance();
+      }
+    }
+  });
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// FAST corners
+////////////////////////////////////////////////////////////////////////
+
+// Radius of the FAST circle, and number of contiguous circle pixels that
+// must all be brighter or all be darker than the center
+#define FAST_RADIUS 3
+#define FAST_ARC 9
+
+// The 16 pixels of the circle, in order around it
+static const int fast_circle[16][2] = {
+  { 0, 3 }, { 1, 3 }, { 2, 2 }, { 3, 1 }, { 3, 0 }, { 3, -1 }, { 2, -2 }, { 1, -3 },
+  { 0, -3 }, { -1, -3 }, { -2, -2 }, { -3, -1 }, { -3, 0 }, { -3, 1 }, { -2, 2 }, { -1, 3 }
+};
+
+
+
+// Returns whether the 16 bit circular mask has FAST_ARC contiguous bits set
+static inline bool 
+HasArc(unsigned int mask)
+{
+  unsigned int run = mask | (mask << 16);
+  for (int k = 1; k < FAST_ARC; k++) run &= (run >> 1);
+  return (run & 0xFFFF) != 0;
+}
+
+
+
+// Computes the FAST score of every pixel of column x (0 for non corners):
+// the summed amount by which the circle pixels exceed the threshold, on the
+// side (brighter or darker) that makes it a corner
+static void 
+ScoreColumn(const float *luminance, int width, int height, int x, float threshold, float *score)
+{
+  // Clear the border of the column (or all of it if it is too close to the border)
+  if ((x < FAST_RADIUS) || (x >= width - FAST_RADIUS)) {
+    for (int y = 0; y < height; y++) score[y] = 0;
+    return;
+  }
+  for (int y = 0; y < FAST_RADIUS; y++) score[y] = score[height - 1 - y] = 0;
+
+  // Offsets of the circle pixels in the plane
+  int offset[16];
+  for (int k = 0; k < 16; k++) offset[k] = fast_circle[k][0] * height + fast_circle[k][1];
+
+  // First pass, branch free so it vectorizes: flag the pixels that pass the
+  // quick test (an arc of 9 covers at least two of the four compass pixels)
+  const float *column = luminance + (size_t) x * height;
+  const float *north = column + offset[0], *east = column + offset[4];
+  const float *south = column + offset[8], *west = column + offset[12];
+  for (int y = FAST_RADIUS; y < height - FAST_RADIUS; y++) {
+    float hi = column[y] + threshold, lo = column[y] - threshold;
+    int nbright = (north[y] > hi) + (east[y] > hi) + (south[y] > hi) + (west[y] > hi);
+    int ndark = (north[y] < lo) + (east[y] < lo) + (south[y] < lo) + (west[y] < lo);
+    score[y] = ((nbright >= 2) || (ndark >= 2)) ? 1.0f : 0.0f;
+  }
+
+  // Second pass: full segment test on the flagged pixels only
+  for (int y = FAST_RADIUS; y < height - FAST_RADIUS; y++) {
+    if (score[y] == 0) continue;
+    const float *p = column + y;
+    float hi = p[0] + threshold, lo = p[0] - threshold;
+    unsigned int bright = 0, dark = 0;
+    float bright_sum = 0, dark_sum = 0;
+    for (int k = 0; k < 16; k++) {
+      float value = p[offset[k]];
+      if (value > hi) { bright |= 1u << k; bright_sum += value - hi; }
+      else if (value < lo) { dark |= 1u << k; dark_sum += lo - value; }
+    }
+    float best = 0;
+    if (HasArc(bright)) best = bright_sum;
+    if (HasArc(dark) && (dark_sum > best)) best = dark_sum;
+    score[y] = best;
+  }
+}
+
+
+
+// Appends the 3x3 local maxima of the score column cur (between prev and next)
+// that are above threshold to features; a pixel must be strictly greater than
+// the neighbors after it in scan order (next column, then up the column), so
+// ties are broken towards the later pixel
+static void 
+SuppressColumn(const float *prev, const float *cur, const float *next, int height, int x, 
+  float threshold, std::vector<R2Feature>& features)
+{
+  for (int y = 1; y < height - 1; y++) {
+    float s = cur[y];
+    if (s <= threshold) continue;
+    if ((s < prev[y-1]) || (s < prev[y]) || (s < prev[y+1]) || (s < cur[y-1])) continue;
+    if ((s <= cur[y+1]) || (s <= next[y-1]) || (s <= next[y]) || (s <= next[y+1])) continue;
+    R2Feature feature;
+    feature.position = R2Point(x, y);
+    feature.score = s;
+    features.push_back(feature);
+  }
+}
+
+
+
+// Orders features from strongest to weakest
+static bool 
+StrongerFeature(const R2Feature& a, const R2Feature& b)
+{
+  return a.score > b.score;
+}
+
+
+
+// Fills features with the strongest candidates (found in bands), spread over
+// the plane by keeping the strongest ones in each cell of a grid, sorted from
+// strongest to weakest
+static void 
+SelectFeatures(const std::vector< std::vector<R2Feature> >& candidates, int width, int height, 
+  int max_features, std::vector<R2Feature>& features)
+{
+  // Distribute the candidates over a grid of roughly square cells
+  int ncellsx = R2_FEATURE_GRID_CELLS, ncellsy = R2_FEATURE_GRID_CELLS;
+  if (width > height) ncellsx = std::max(1, (int) (R2_FEATURE_GRID_CELLS * (double) width / height + 0.5));
+  else ncellsy = std::max(1, (int) (R2_FEATURE_GRID_CELLS * (double) height / width + 0.5));
+  int ncells = ncellsx * ncellsy;
+  std::vector< std::vector<R2Feature> > cells(ncells);
+  for (size_t b = 0; b < candidates.size(); b++) {
+    for (size_t i = 0; i < candidates[b].size(); i++) {
+      const R2Feature& feature = candidates[b][i];
+      int cx = (int) feature.position.X() * ncellsx / width;
+      int cy = (int) feature.position.Y() * ncellsy / height;
+      cells[cx * ncellsy + cy].push_back(feature);
+    }
+  }
+
+  // Keep the strongest features of each cell (partial selection, no full sort)
+  int quota = (max_features + ncells - 1) / ncells;
+  for (int c = 0; c < ncells; c++) {
+    std::vector<R2Feature>& cell = cells[c];
+    if ((int) cell.size() > quota) {
+      std::nth_element(cell.begin(), cell.begin() + quota, cell.end(), StrongerFeature);
+      cell.resize(quota);
+    }
+    features.insert(features.end(), cell.begin(), cell.end());
+  }
+
+  // Trim the rounding excess, and sort from strongest to weakest
+  if ((int) features.size() > max_features) {
+    std::nth_element(features.begin(), features.begin() + max_features, features.end(), StrongerFeature);
+    features.resize(max_features);
+  }
+  std::sort(features.begin(), features.end(), StrongerFeature);
+}
+
+
+
+int 
+R2DetectFeatures(const float *luminance, int width, int height, std::vector<R2Feature>& features,
+  int max_features, double threshold)
+{
+  // Initialize result
+  features.clear();
+  if ((width < 2*FAST_RADIUS + 1) || (height < 2*FAST_RADIUS + 1) || (max_features <= 0)) return 0;
+
+  // Detect corners in bands of columns, in parallel; each band keeps the scores
+  // of three consecutive columns only, which is all non-maximum suppression needs
+  int nbands = std::min(width, 4 * R2NumThreads());
+  std::vector< std::vector<R2Feature> > candidates(nbands);
+  R2ParallelFor(0, nbands, nbands, [&](int begin, int end) {
+    std::vector<float> buffer(3 * (size_t) height);
+    for (int b = begin; b < end; b++) {
+      int x0 = (int) ((long long) b * width / nbands);
+      int x1 = (int) ((long long) (b + 1) * width / nbands);
+      float *prev = &buffer[0], *cur = &buffer[height], *next = &buffer[2*height];
+      ScoreColumn(luminance, width, height, x0 - 1, (float) threshold, prev);
+      ScoreColumn(luminance, width, height, x0, (float) threshold, cur);
+      for (int x = x0; x < x1; x++) {
+        ScoreColumn(luminance, width, height, x + 1, (float) threshold, next);
+        SuppressColumn(prev, cur, next, height, x, 0.0f, candidates[b]);
+        float *swap = prev; prev = cur; cur = next; next = swap;
+      }
+    }
+  });
+
+  // Keep the strongest, spread over the plane
+  SelectFeatures(candidates, width, height, max_features, features);
+
+  // Return number of features
+  return (int) features.size();
+}
+
+
+
+int 
+R2DetectFeatures(const R2Image& image, std::vector<R2Feature>& features, int max_features, double threshold)
+{
+  // Detect features on the luminance of the image
+  std::vector<float> luminance;
+  R2ComputeLuminance(image, luminance);
+  return R2DetectFeatures(luminance.data(), image.Width(), image.Height(), features, max_features, threshold);
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Harris corners
+////////////////////////////////////////////////////////////////////////
+
+// Size of the tiles the response is computed on (the tiles grow with sigma,
+// so their halos never dominate)
+#define HARRIS_TILE 128
+
+// Scale of squared Sobel gradients, so they are squared derivatives
+#define HARRIS_GRADIENT_SCALE (1.0f / 64)
+
+
+
+void 
+R2ComputeHarrisResponse(const float *luminance, int width, int height, double sigma, float *response, double k)
+{
+  // Each tile is computed from a copy of the luminance around it, with a halo
+  // wide enough for the gradients and the Gaussian window, so the gradient
+  // and structure tensor planes only ever exist at tile size
+  int halo = (int) R2GaussianKernel(sigma).size();
+  int tile = std::max(HARRIS_TILE, 4 * halo);
+  int ntilesx = (width + tile - 1) / tile, ntilesy = (height + tile - 1) / tile;
+  const float kf = (float) k, scale = HARRIS_GRADIENT_SCALE;
+
+  R2ParallelFor(0, ntilesx * ntilesy, R2NumThreads(), [&](int begin, int end) {
+    int size = (tile + 2 * halo) * (tile + 2 * halo);
+    std::vector<float> buffer(6 * (size_t) size);
+    float *input = &buffer[0], *ix = &buffer[size], *iy = &buffer[2*size];
+    float *ixx = &buffer[3*size], *iyy = &buffer[4*size], *ixy = &buffer[5*size];
+    for (int t = begin; t < end; t++) {
+      // Copy the tile and its halo (repeating the border pixels of the plane)
+      int x0 = (t / ntilesy) * tile, y0 = (t % ntilesy) * tile;
+      int x1 = std::min(x0 + tile, width), y1 = std::min(y0 + tile, height);
+      int tw = x1 - x0 + 2 * halo, th = y1 - y0 + 2 * halo;
+      for (int i = 0; i < tw; i++) {
+        int x = std::min(std::max(x0 - halo + i, 0), width - 1);
+        const float *src = luminance + (size_t) x * height;
+        float *dst = input + i * th - (y0 - halo);
+        int j0 = std::max(y0 - halo, 0), j1 = std::min(y1 + halo, height);
+        for (int j = y0 - halo; j < j0; j++) dst[j] = src[0];
+        std::copy(src + j0, src + j1, dst + j0);
+        for (int j = j1; j < y1 + halo; j++) dst[j] = src[height - 1];
+      }
+
+      // Structure tensor products, then the window around each pixel
+      // (the blurred products replace the planes that are no longer needed)
+      R2SobelGradients(input, tw, th, ix, iy, ixx, iyy, ixy);
+      R2GaussianBlur(ixx, tw, th, sigma, ix);
+      R2GaussianBlur(iyy, tw, th, sigma, iy);
+      R2GaussianBlur(ixy, tw, th, sigma, input);
+      const float *sxx = ix, *syy = iy, *sxy = input;
+
+      // Response of the pixels of the tile
+      for (int i = halo; i < tw - halo; i++) {
+        float *dst = response + (size_t) (x0 + i - halo) * height + y0;
+        const float *a = sxx + i * th + halo, *b = syy + i * th + halo, *c = sxy + i * th + halo;
+        for (int j = 0; j < th - 2 * halo; j++) {
+          float xx = scale * a[j], yy = scale * b[j], xy = scale * c[j];
+          float trace = xx + yy;
+          dst[j] = xx * yy - xy * xy - kf * trace * trace;
+        }
+      }
+    }
+  });
+}
+
+
+
+int 
+R2DetectHarrisCorners(const float *luminance, int width, int height, double sigma,
+  std::vector<float>& response, std::vector<R2Feature>& features, int max_features, double threshold, double k)
+{
+  // Compute the response
+  features.clear();
+  response.resize((size_t) width * height);
+  R2ComputeHarrisResponse(luminance, width, height, sigma, response.data(), k);
+  if ((width < 3) || (height < 3) || (max_features <= 0)) return 0;
+
+  // Find its local maxima in bands of columns, in parallel
+  int nbands = std::min(width - 2, 4 * R2NumThreads());
+  std::vector< std::vector<R2Feature> > candidates(nbands);
+  R2ParallelFor(0, nbands, nbands, [&](int begin, int end) {
+    for (int b = begin; b < end; b++) {
+      int x0 = 1 + (int) ((long long) b * (width - 2) / nbands);
+      int x1 = 1 + (int) ((long long) (b + 1) * (width - 2) / nbands);
+      for (int x = x0; x < x1; x++) {
+        const float *cur = &response[(size_t) x * height];
+        SuppressColumn(cur - height, cur, cur + height, height, x, (float) threshold, candidates[b]);
+      }
+    }
+  });
+
+  // Keep the strongest, spread over the plane
+  SelectFeatures(candidates, width, height, max_features, features);
+
+  // Return number of corners
+  return (int) features.size();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Descriptors
+////////////////////////////////////////////////////////////////////////
+
+// Scale of the quantized descriptor values, in standard deviations per level
+#define DESCRIPTOR_SCALE 32.0f
+
+
+
+void 
+R2ComputeDescriptors(const float *luminance, int width, int height, 
+  const std::vector<R2Feature>& features, std::vector<unsigned char>& descriptors)
+{
+  const int nfeatures = (int) features.size();
+  descriptors.resize((size_t) nfeatures * R2_FEATURE_DESCRIPTOR_SIZE);
+
+  R2ParallelFor(0, nfeatures, R2NumThreads(), [&](int begin, int end) {
+    for (int f = begin; f < end; f++) {
+      // Sample the patch (the border is repeated for features close to it)
+      float patch[R2_FEATURE_DESCRIPTOR_SIZE];
+      int cx = (int) (features[f].position.X() + 0.5), cy = (int) (features[f].position.Y() + 0.5);
+      int origin = -R2_FEATURE_PATCH_SAMPLES * R2_FEATURE_PATCH_STEP / 2;
+      float mean = 0;
+      for (int i = 0; i < R2_FEATURE_PATCH_SAMPLES; i++) {
+        int x0 = cx + origin + i * R2_FEATURE_PATCH_STEP;
+        int x1 = x0 + 1;
+        x0 = std::min(std::max(x0, 0), width - 1);
+        x1 = std::min(std::max(x1, 0), width - 1);
+        const float *column0 = luminance + (size_t) x0 * height;
+        const float *column1 = luminance + (size_t) x1 * height;
+        for (int j = 0; j < R2_FEATURE_PATCH_SAMPLES; j++) {
+          int y0 = cy + origin + j * R2_FEATURE_PATCH_STEP;
+          int y1 = y0 + 1;
+          y0 = std::min(std::max(y0, 0), height - 1);
+          y1 = std::min(std::max(y1, 0), height - 1);
+          float value = 0.25f * (column0[y0] + column0[y1] + column1[y0] + column1[y1]);
+          patch[i * R2_FEATURE_PATCH_SAMPLES + j] = value;
+          mean += value;
+        }
+      }
+
+      // Normalize and quantize it around 128
+      mean /= R2_FEATURE_DESCRIPTOR_SIZE;
+      float variance = 0;
+      for (int k = 0; k < R2_FEATURE_DESCRIPTOR_SIZE; k++) variance += (patch[k] - mean) * (patch[k] - mean);
+      variance /= R2_FEATURE_DESCRIPTOR_SIZE;
+      float scale = (variance > 1e-12f) ? DESCRIPTOR_SCALE / sqrtf(variance) : 0.0f;
+      unsigned char *descriptor = &descriptors[(size_t) f * R2_FEATURE_DESCRIPTOR_SIZE];
+      for (int k = 0; k < R2_FEATURE_DESCRIPTOR_SIZE; k++) {
+        float value = 128.0f + (patch[k] - mean) * scale;
+        descriptor[k] = (unsigned char) std::min(std::max(value + 0.5f, 0.0f), 255.0f);
+      }
+    }
+  });
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Matching
+////////////////////////////////////////////////////////////////////////
+
+// Nearest and second nearest neighbors of a descriptor
+struct R2FeatureNeighbors {
+  int index;
+  int distance, second_distance;
+};
+
+
+
+// Returns the sum of squared differences between two descriptors (integer
+// arithmetic, so the compiler vectorizes the reduction)
+static inline int 
+DescriptorDistance(const unsigned char *a, const unsigned char *b)
+{
+  int sum = 0;
+  for (int k = 0; k < R2_FEATURE_DESCRIPTOR_SIZE; k++) {
+    int d = (int) a[k] - (int) b[k];
+    sum += d * d;
+  }
+  return sum;
+}
+
+
+
+// Updates the nearest neighbors with a candidate
+static inline void 
+UpdateNeighbors(R2FeatureNeighbors& neighbors, int index, int distance)
+{
+  if (distance < neighbors.distance) {
+    neighbors.second_distance = neighbors.distance;
+    neighbors.distance = distance;
+    neighbors.index = index;
+  }
+  else if (distance < neighbors.second_distance) {
+    neighbors.second_distance = distance;
+  }
+}
+
+
+
+// Largest number of grid cells along either axis of FindNeighbors, so a
+// small max_displacement cannot make the grid bigger than the features
+#define FIND_NEIGHBORS_MAX_CELLS 256
+
+
+
+// Finds the nearest neighbors in the train set of every query descriptor, by
+// brute force (always, without a positive max_displacement) or among the train
+// features in the grid cells around the query position
+static void 
+FindNeighbors(const std::vector<R2Feature>& queries, const std::vector<unsigned char>& query_descriptors,
+  const std::vector<R2Feature>& train, const std::vector<unsigned char>& train_descriptors,
+  double max_displacement, std::vector<R2FeatureNeighbors>& neighbors)
+{
+  const int nqueries = (int) queries.size(), ntrain = (int) train.size();
+  neighbors.resize(nqueries);
+
+  // Bucket the train features into cells of at least max_displacement pixels
+  // (larger if there would be too many), so the features within
+  // max_displacement of a position are in its cell or the ones around it
+  const bool use_grid = (max_displacement > 0);
+  double xmin = 0, ymin = 0, cell_size = max_displacement;
+  int ncellsx = 1, ncellsy = 1;
+  std::vector<int> cell_start, cell_features;
+  if (use_grid) {
+    double xmax = 0, ymax = 0;
+    for (int t = 0; t < ntrain; t++) {
+      const R2Point& p = train[t].position;
+      if ((t == 0) || (p.X() < xmin)) xmin = p.X();
+      if ((t == 0) || (p.Y() < ymin)) ymin = p.Y();
+      if ((t == 0) || (p.X() > xmax)) xmax = p.X();
+      if ((t == 0) || (p.Y() > ymax)) ymax = p.Y();
+    }
+    cell_size = std::max(cell_size, std::max(xmax - xmin, ymax - ymin) / FIND_NEIGHBORS_MAX_CELLS);
+    ncellsx = (int) ((xmax - xmin) / cell_size) + 1;
+    ncellsy = (int) ((ymax - ymin) / cell_size) + 1;
+    cell_start.assign(ncellsx * ncellsy + 1, 0);
+    cell_features.resize(ntrain);
+    std::vector<int> cell_of(ntrain);
+    for (int t = 0; t < ntrain; t++) {
+      int cx = std::min((int) ((train[t].position.X() - xmin) / cell_size), ncellsx - 1);
+      int cy = std::min((int) ((train[t].position.Y() - ymin) / cell_size), ncellsy - 1);
+      cell_of[t] = cx * ncellsy + cy;
+      cell_start[cell_of[t] + 1]++;
+    }
+    for (int c = 0; c < ncellsx * ncellsy; c++) cell_start[c + 1] += cell_start[c];
+    std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+    for (int t = 0; t < ntrain; t++) cell_features[fill[cell_of[t]]++] = t;
+  }
+  const double max_displacement2 = max_displacement * max_displacement;
+
+  // Search, in parallel over the queries
+  R2ParallelFor(0, nqueries, R2NumThreads(), [&](int begin, int end) {
+    for (int q = begin; q < end; q++) {
+      const unsigned char *descriptor = &query_descriptors[(size_t) q * R2_FEATURE_DESCRIPTOR_SIZE];
+      R2FeatureNeighbors& result = neighbors[q];
+      result.index = -1;
+      result.distance = result.second_distance = INT_MAX;
+
+      if (!use_grid) {
+        for (int t = 0; t < ntrain; t++) {
+          UpdateNeighbors(result, t, DescriptorDistance(descriptor, &train_descriptors[(size_t) t * R2_FEATURE_DESCRIPTOR_SIZE]));
+        }
+        continue;
+      }
+
+      const R2Point& p = queries[q].position;
+      double u = floor((p.X() - xmin) / cell_size), v = floor((p.Y() - ymin) / cell_size);
+      int cx = (int) std::min(std::max(u, -2.0), (double) ncellsx + 1);
+      int cy = (int) std::min(std::max(v, -2.0), (double) ncellsy + 1);
+      for (int i = std::max(cx - 1, 0); i <= std::min(cx + 1, ncellsx - 1); i++) {
+        for (int j = std::max(cy - 1, 0); j <= std::min(cy + 1, ncellsy - 1); j++) {
+          int c = i * ncellsy + j;
+          for (int k = cell_start[c]; k < cell_start[c + 1]; k++) {
+            int t = cell_features[k];
+            double dx = train[t].position.X() - p.X(), dy = train[t].position.Y() - p.Y();
+            if (dx*dx + dy*dy > max_displacement2) continue;
+            UpdateNeighbors(result, t, DescriptorDistance(descriptor, &train_descriptors[(size_t) t * R2_FEATURE_DESCRIPTOR_SIZE]));
+          }
+        }
+      }
+    }
+  });
+}
+
+
+
+// Orders matches from best to worst
+static bool 
+BetterMatch(const R2FeatureMatch& a, const R2FeatureMatch& b)
+{
+  return a.distance < b.distance;
+}
+
+
+
+int 
+R2MatchFeatures(const std::vector<R2Feature>& features1, const std::vector<unsigned char>& descriptors1,
+  const std::vector<R2Feature>& features2, const std::vector<unsigned char>& descriptors2,
+  std::vector<R2FeatureMatch>& matches, double ratio, int cross_check, double max_displacement)
+{
+  // Find nearest neighbors in both directions
+  std::vector<R2FeatureNeighbors> forward, backward;
+  FindNeighbors(features1, descriptors1, features2, descriptors2, max_displacement, forward);
+  if (cross_check) FindNeighbors(features2, descriptors2, features1, descriptors1, max_displacement, backward);
+
+  // Keep the distinctive (and consistent) ones; distances are squared, so is the ratio
+  const double ratio2 = ratio * ratio;
+  matches.clear();
+  for (int i = 0; i < (int) forward.size(); i++) {
+    const R2FeatureNeighbors& n = forward[i];
+    if (n.index < 0) continue;
+    if ((n.second_distance != INT_MAX) && (n.distance >= ratio2 * n.second_distance)) continue;
+    if (cross_check && (backward[n.index].index != i)) continue;
+    R2FeatureMatch match;
+    match.index1 = i;
+    match.index2 = n.index;
+    match.distance = n.distance;
+    matches.push_back(match);
+  }
+
+  // Sort them from best to worst
+  std::sort(matches.begin(), matches.end(), BetterMatch);
+
+  // Return number of matches
+  return (int) matches.size();
+}
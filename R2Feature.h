@@ -0,0 +1,102 @@
+// Include file for feature detection
+#ifndef R2_FEATURE_INCLUDED
+#define R2_FEATURE_INCLUDED
+
+
+
+// Include files
+
+#include <vector>
+
+
+
+// Constant definitions
+
+#define R2_FEATURE_FAST_THRESHOLD 0.08
+#define R2_FEATURE_GRID_CELLS 8
+#define R2_FEATURE_MAX_FEATURES 1000
+#define R2_FEATURE_PATCH_SAMPLES 8
+#define R2_FEATURE_PATCH_STEP 2
+#define R2_FEATURE_DESCRIPTOR_SIZE (R2_FEATURE_PATCH_SAMPLES * R2_FEATURE_PATCH_SAMPLES)
+#define R2_FEATURE_MATCH_RATIO 0.8
+#define R2_FEATURE_HARRIS_K 0.04
+#define R2_FEATURE_HARRIS_THRESHOLD 1e-7
+
+
+
+// Class definition
+
+struct R2Feature {
+  // Pixel position and corner strength (larger is stronger)
+  R2Point position;
+  double score;
+};
+
+struct R2FeatureMatch {
+  // Indices of the matched features in both sets, and their descriptor distance
+  int index1, index2;
+  int distance;
+};
+
+
+
+// Function declarations
+
+// Fills luminance with the luminance of every pixel, laid out like the
+// pixels of the image (luminance[x*height + y])
+void R2ComputeLuminance(const R2Image& image, std::vector<float>& luminance);
+
+// Detects FAST corners on a luminance plane (laid out as above), keeping only
+// those that are maxima of their 3x3 neighborhood.  The plane is split into
+// a grid with R2_FEATURE_GRID_CELLS cells along its shorter side, and only the
+// strongest features of each cell are kept so they cover the whole image.
+// Returns the number of features, sorted from strongest to weakest
+int R2DetectFeatures(const float *luminance, int width, int height, std::vector<R2Feature>& features,
+  int max_features = R2_FEATURE_MAX_FEATURES, double threshold = R2_FEATURE_FAST_THRESHOLD);
+int R2DetectFeatures(const R2Image& image, std::vector<R2Feature>& features,
+  int max_features = R2_FEATURE_MAX_FEATURES, double threshold = R2_FEATURE_FAST_THRESHOLD);
+
+// Computes the Harris corner response det(M) - k trace(M)^2 of every pixel of
+// a luminance plane (laid out as above), where M is the structure tensor of the
+// Sobel gradients (scaled to derivatives) weighted by a Gaussian of standard
+// deviation sigma.  The plane is processed in tiles, in parallel, each from a
+// copy of the luminance around it, so no gradient or tensor plane is ever
+// allocated at full size.  Responses are positive at corners, negative along
+// edges and close to 0 in flat regions
+void R2ComputeHarrisResponse(const float *luminance, int width, int height, double sigma, float *response,
+  double k = R2_FEATURE_HARRIS_K);
+
+// Computes the Harris response as above and detects corners at its 3x3 maxima
+// above threshold, kept over the grid like the FAST features; returns the
+// number of corners, sorted from strongest to weakest
+int R2DetectHarrisCorners(const float *luminance, int width, int height, double sigma,
+  std::vector<float>& response, std::vector<R2Feature>& features, int max_features = R2_FEATURE_MAX_FEATURES,
+  double threshold = R2_FEATURE_HARRIS_THRESHOLD, double k = R2_FEATURE_HARRIS_K);
+
+
+// Computes a descriptor of R2_FEATURE_DESCRIPTOR_SIZE bytes for each feature
+// (descriptors[i*R2_FEATURE_DESCRIPTOR_SIZE...]): the 2x2 averaged luminance
+// patch around the feature on an 8x8 grid with a spacing of 2 pixels,
+// normalized to zero mean and unit variance and quantized to 8 bits, so
+// descriptors are insensitive to brightness and contrast changes
+void R2ComputeDescriptors(const float *luminance, int width, int height, 
+  const std::vector<R2Feature>& features, std::vector<unsigned char>& descriptors);
+
+// Matches each feature of the first set to the feature of the second set with
+// the nearest descriptor (sum of squared differences), keeping the match only
+// if it is clearly better than the second nearest (distance below ratio times
+// the second distance) and, with cross_check, if the first feature is also the
+// nearest to the second.  With a positive max_displacement, only features
+// within that many pixels of each other are compared, using a grid over the
+// second set.  Without it, every pair is compared whatever the sizes of the
+// sets (the grid indexes positions, which then bound nothing, and descriptors
+// of this size gain little from a tree).  Fills matches sorted from best to
+// worst and returns their number
+int R2MatchFeatures(const std::vector<R2Feature>& features1, const std::vector<unsigned char>& descriptors1,
+  const std::vector<R2Feature>& features2, const std::vector<unsigned char>& descriptors2,
+  std::vector<R2FeatureMatch>& matches, double ratio = R2_FEATURE_MATCH_RATIO, int cross_check = 1,
+  double max_displacement = 0);
+
+
+
+#endif
@@ -0,0 +1,483 @@
+// Source file for linear filters on float planes
+
+
+
+// Include files
+
+#include "R2/R2.h"
+#include "R2Pixel.h"
+#include "R2Image.h"
+#include "R2Filter.h"
+#include "R2Convolve.h"
+#include "R2PixelOperations.h"
+#include "R2IntegralImage.h"
+#include "R2Parallel.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Channel planes
+////////////////////////////////////////////////////////////////////////
+
+void
+R2ImageToPlanes(const R2Image& image, std::vector<float> planes[R2_IMAGE_NUM_CHANNELS],
+  const R2PixelOperations *operations)
+{
+  int width = image.Width(), height = image.Height();
+  for (int k = 0; k < R2_IMAGE_NUM_CHANNELS; k++) planes[k].resize((size_t) width * height);
+  if (operations && operations->IsEmpty()) operations = NULL;
+
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      const R2Pixel *src = image[i];
+      if (operations) {
+        // Copy each pixel to apply the operations, then scatter its channels
+        for (int j = 0; j < height; j++) {
+          R2Pixel pixel(src[j]);
+          operations->Apply(pixel);
+          for (int k = 0; k < R2_IMAGE_NUM_CHANNELS; k++) planes[k][(size_t) i * height + j] = (float) pixel[k];
+        }
+        continue;
+      }
+      for (int k = 0; k < R2_IMAGE_NUM_CHANNELS; k++) {
+        float *dst = &planes[k][(size_t) i * height];
+        for (int j = 0; j < height; j++) dst[j] = (float) src[j][k];
+      }
+    }
+  });
+}
+
+
+
+void
+R2PlanesToImage(const std::vector<float> planes[R2_IMAGE_NUM_CHANNELS], R2Image& image)
+{
+  int width = image.Width(), height = image.Height();
+
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      R2Pixel *dst = image[i];
+      const float *src[R2_IMAGE_NUM_CHANNELS];
+      for (int k = 0; k < R2_IMAGE_NUM_CHANNELS; k++) src[k] = &planes[k][(size_t) i * height];
+      for (int j = 0; j < height; j++) {
+        for (int k = 0; k < R2_IMAGE_NUM_CHANNELS; k++) dst[j][k] = src[k][j];
+      }
+    }
+  });
+}
+
+
+
+void
+R2ImageToPlane(const R2Image& image, int channel, float *plane)
+{
+  int height = image.Height();
+
+  R2ParallelFor(0, image.Width(), R2NumThreads(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      const R2Pixel *src = image[i];
+      float *dst = plane + (size_t) i * height;
+      for (int j = 0; j < height; j++) dst[j] = (float) src[j][channel];
+    }
+  });
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Direct Gaussian blur
+////////////////////////////////////////////////////////////////////////
+
+const std::vector<float>&
+R2GaussianKernel(double sigma, int derivative)
+{
+  // Kernels are never erased, so references into the cache stay valid
+  static std::mutex mutex;
+  static std::map<std::pair<int, double>, std::vector<float> > cache;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<float>& kernel = cache[std::make_pair(derivative, sigma)];
+  if (!kernel.empty()) return kernel;
+
+  // A Gaussian of no width is the identity (and its second derivative 0)
+  if (sigma <= 0) {
+    kernel.assign(1, (derivative == 2) ? 0.0f : 1.0f);
+    return kernel;
+  }
+
+  // Sample the Gaussian, and normalize so the full (symmetric) kernel sums to 1
+  int radius = (int) ceil(R2_FILTER_GAUSSIAN_CUTOFF * sigma);
+  std::vector<double> weights(radius + 1);
+  double sum = 0;
+  for (int i = 0; i <= radius; i++) {
+    weights[i] = exp(-0.5 * i * i / (sigma * sigma));
+    sum += (i == 0) ? weights[i] : 2 * weights[i];
+  }
+  for (int i = 0; i <= radius; i++) weights[i] /= sum;
+
+  // Second derivative: (i^2 - sigma^2) / sigma^4 times the Gaussian, made to
+  // sum to 0 (less a multiple of the Gaussian) and scaled so that it gives 2
+  // on i^2, as the truncated samples do neither exactly
+  if (derivative == 2) {
+    std::vector<double> gaussian(weights);
+    double offset = 0, moment = 0;
+    for (int i = 0; i <= radius; i++) {
+      weights[i] = (i * i - sigma * sigma) / (sigma * sigma * sigma * sigma) * gaussian[i];
+      offset += (i == 0) ? weights[i] : 2 * weights[i];
+    }
+    for (int i = 0; i <= radius; i++) {
+      weights[i] -= offset * gaussian[i];
+      moment += 2 * i * i * weights[i];
+    }
+    for (int i = 0; i <= radius; i++) weights[i] *= 2 / moment;
+  }
+
+  // Return kernel
+  kernel.resize(radius + 1);
+  for (int i = 0; i <= radius; i++) kernel[i] = (float) weights[i];
+  return kernel;
+}
+
+
+
+// Returns the full kernel of a symmetric one given as its radius + 1 taps
+static std::vector<float>
+FullKernel(const std::vector<float>& half)
+{
+  int radius = (int) half.size() - 1;
+  std::vector<float> kernel(2 * radius + 1);
+  for (int i = 0; i <= radius; i++) kernel[radius - i] = kernel[radius + i] = half[i];
+  return kernel;
+}
+
+
+
+// Blurs with the sampled kernel: the cost per pixel grows with sigma
+static void
+DirectGaussianBlur(const float *plane, int width, int height, double sigma, float *blurred)
+{
+  // Nothing to do for a one tap kernel
+  const std::vector<float>& kernel = R2GaussianKernel(sigma);
+  if (kernel.size() == 1) {
+    if (blurred != plane) std::copy(plane, plane + (size_t) width * height, blurred);
+    return;
+  }
+
+  // Filter with the kernel in both directions
+  std::vector<float> full = FullKernel(kernel);
+  R2ConvolveSeparable(plane, width, height, full.data(), (int) full.size(), full.data(), (int) full.size(), blurred);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Recursive Gaussian blur
+////////////////////////////////////////////////////////////////////////
+
+// Young and van Vliet's third order recursive approximation of a Gaussian
+//    ("Recursive implementation of the Gaussian filter", 1995): a causal pass
+//    w[n] = b x[n] + a1 w[n-1] + a2 w[n-2] + a3 w[n-3], then the same filter
+//    anti-causally on w.  The border is repeated as for the direct blur: the
+//    causal pass starts from the steady state of the first value, and the
+//    anti-causal one from the states that the causal filter run on past the
+//    end (over the last value repeated) would lead to.  These are linear in
+//    the deviations of the last three w from the last value, with a 3x3
+//    matrix m found once per sigma by running the filters on each deviation
+//    (Triggs and Sdika give it in closed form)
+struct R2RecursiveGaussian {
+  double b;
+  double a[3];
+  double m[3][3];
+};
+
+// Number of columns filtered together along the columns
+#define RECURSIVE_LANES 8
+
+// Number of rows filtered together across the columns
+#define RECURSIVE_TILE_HEIGHT 64
+
+
+
+// Returns the recursive filter for a sigma of at least 0.5 (cached like the kernels)
+static const R2RecursiveGaussian& 
+RecursiveGaussian(double sigma)
+{
+  static std::mutex mutex;
+  static std::map<double, R2RecursiveGaussian> cache;
+  std::lock_guard<std::mutex> lock(mutex);
+  std::map<double, R2RecursiveGaussian>::iterator it = cache.find(sigma);
+  if (it != cache.end()) return it->second;
+  R2RecursiveGaussian& g = cache[sigma];
+
+  // Compute the coefficients
+  double q = (sigma >= 2.5) ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * sqrt(1 - 0.26891 * sigma);
+  double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+  double b1 = 2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q;
+  double b2 = -(1.4281 * q * q + 1.26661 * q * q * q);
+  double b3 = 0.422205 * q * q * q;
+  g.a[0] = b1 / b0;
+  g.a[1] = b2 / b0;
+  g.a[2] = b3 / b0;
+  g.b = 1 - g.a[0] - g.a[1] - g.a[2];
+
+  // Run the filters past the end on each deviation (e[0..2] are the last
+  // three w, the causal filter then continues on zero input), until the
+  // responses have died out
+  int n = (int) (20 * sigma) + 100;
+  std::vector<double> e(n + 6), f(n + 6);
+  for (int j = 0; j < 3; j++) {
+    std::fill(e.begin(), e.end(), 0.0);
+    std::fill(f.begin(), f.end(), 0.0);
+    e[2 - j] = 1;
+    for (int i = 3; i < n + 3; i++) e[i] = g.a[0] * e[i-1] + g.a[1] * e[i-2] + g.a[2] * e[i-3];
+    for (int i = n + 2; i >= 3; i--) f[i] = g.b * e[i] + g.a[0] * f[i+1] + g.a[1] * f[i+2] + g.a[2] * f[i+3];
+    for (int k = 0; k < 3; k++) g.m[k][j] = f[3 + k];
+  }
+
+  // Return filter
+  return g;
+}
+
+
+
+// Runs the recursive filter in place along n steps, on lanes values per step
+//    (value c of step i is data[i*stride + c]); n must be at least 3
+static void
+RecursiveFilter(float *data, int n, size_t stride, int lanes, const R2RecursiveGaussian& g, std::vector<float>& scratch)
+{
+  // (b is rounded so the gain on constant values is as close to 1 as possible)
+  const float a1 = (float) g.a[0], a2 = (float) g.a[1], a3 = (float) g.a[2];
+  const float b = 1 - (a1 + a2 + a3);
+  scratch.resize(4 * lanes);
+  float *last = &scratch[0];
+  float *state[3] = { &scratch[lanes], &scratch[2 * lanes], &scratch[3 * lanes] };
+  const float *end = data + (n - 1) * stride;
+  for (int c = 0; c < lanes; c++) last[c] = end[c];
+
+  // Causal pass (the first step is its own steady state)
+  for (int i = 1; i < n; i++) {
+    float *w = data + i * stride;
+    const float *w1 = w - stride;
+    const float *w2 = data + std::max(i - 2, 0) * stride;
+    const float *w3 = data + std::max(i - 3, 0) * stride;
+    for (int c = 0; c < lanes; c++) w[c] = b * w[c] + a1 * w1[c] + a2 * w2[c] + a3 * w3[c];
+  }
+
+  // Anti-causal states past the end
+  const float *e0 = end, *e1 = end - stride, *e2 = end - 2 * stride;
+  for (int k = 0; k < 3; k++) {
+    const float m0 = (float) g.m[k][0], m1 = (float) g.m[k][1], m2 = (float) g.m[k][2];
+    for (int c = 0; c < lanes; c++) {
+      state[k][c] = last[c] + m0 * (e0[c] - last[c]) + m1 * (e1[c] - last[c]) + m2 * (e2[c] - last[c]);
+    }
+  }
+
+  // Anti-causal pass
+  for (int i = n - 1; i >= 0; i--) {
+    float *y = data + i * stride;
+    const float *y1 = (i + 1 < n) ? y + stride : state[i + 1 - n];
+    const float *y2 = (i + 2 < n) ? y + 2 * stride : state[i + 2 - n];
+    const float *y3 = (i + 3 < n) ? y + 3 * stride : state[i + 3 - n];
+    for (int c = 0; c < lanes; c++) y[c] = b * y[c] + a1 * y1[c] + a2 * y2[c] + a3 * y3[c];
+  }
+}
+
+
+
+// Blurs with the recursive filter: the cost per pixel does not depend on sigma
+static void
+RecursiveGaussianBlur(const float *plane, int width, int height, double sigma, float *blurred)
+{
+  const R2RecursiveGaussian& g = RecursiveGaussian(sigma);
+
+  // Filter along the columns, RECURSIVE_LANES columns at a time interleaved
+  // in a buffer, so each step of the recursion is a short vector
+  int nblocks = (width + RECURSIVE_LANES - 1) / RECURSIVE_LANES;
+  R2ParallelFor(0, nblocks, R2NumThreads(), [&](int begin, int end) {
+    std::vector<float> buffer((size_t) height * RECURSIVE_LANES), scratch;
+    for (int block = begin; block < end; block++) {
+      const float *src[RECURSIVE_LANES];
+      float *dst[RECURSIVE_LANES];
+      for (int c = 0; c < RECURSIVE_LANES; c++) {
+        int x = std::min(block * RECURSIVE_LANES + c, width - 1);
+        src[c] = plane + (size_t) x * height;
+        dst[c] = blurred + (size_t) x * height;
+      }
+      for (int j = 0; j < height; j++) {
+        for (int c = 0; c < RECURSIVE_LANES; c++) buffer[j * RECURSIVE_LANES + c] = src[c][j];
+      }
+      RecursiveFilter(buffer.data(), height, RECURSIVE_LANES, RECURSIVE_LANES, g, scratch);
+      for (int c = 0; c < RECURSIVE_LANES; c++) {
+        if ((c > 0) && (dst[c] == dst[c-1])) break;
+        for (int j = 0; j < height; j++) dst[c][j] = buffer[j * RECURSIVE_LANES + c];
+      }
+    }
+  });
+
+  // Filter across the columns in place, on tiles of rows (the recursion
+  // steps are then contiguous pieces of columns)
+  int ntiles = (height + RECURSIVE_TILE_HEIGHT - 1) / RECURSIVE_TILE_HEIGHT;
+  R2ParallelFor(0, ntiles, R2NumThreads(), [&](int begin, int end) {
+    std::vector<float> scratch;
+    for (int t = begin; t < end; t++) {
+      int y0 = t * RECURSIVE_TILE_HEIGHT, y1 = std::min(height, y0 + RECURSIVE_TILE_HEIGHT);
+      RecursiveFilter(blurred + y0, width, height, y1 - y0, g, scratch);
+    }
+  });
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Box blur
+////////////////////////////////////////////////////////////////////////
+
+// Blurs with box filters of odd widths chosen so that the variances of the
+//    passes add up to sigma^2 (Kovesi, "Fast almost-Gaussian filtering", 2010):
+//    the first passes use the largest odd width below the ideal one and the
+//    others the next odd width
+static void
+BoxGaussianBlur(const float *plane, int width, int height, double sigma, float *blurred)
+{
+  const int n = R2_FILTER_BOX_PASSES;
+  double variance = sigma * sigma;
+  int small_width = (int) floor(sqrt(12 * variance / n + 1));
+  if (small_width % 2 == 0) small_width--;
+  if (small_width < 1) small_width = 1;
+  double nsmall = (12 * variance - n * small_width * small_width - 4 * n * small_width - 3 * n) / (-4.0 * small_width - 4);
+  int small_passes = (int) floor(nsmall + 0.5);
+
+  for (int i = 0; i < n; i++) {
+    int radius = (i < small_passes) ? small_width / 2 : small_width / 2 + 1;
+    R2BoxFilter((i == 0) ? plane : blurred, width, height, radius, blurred);
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Gaussian blur
+////////////////////////////////////////////////////////////////////////
+
+void
+R2GaussianBlur(const float *plane, int width, int height, double sigma, float *blurred, int method)
+{
+  // Choose the recursive filter for large sigmas
+  if (method == R2_IMAGE_AUTOMATIC_BLUR) {
+    method = (sigma >= R2_FILTER_RECURSIVE_SIGMA) ? R2_IMAGE_RECURSIVE_BLUR : R2_IMAGE_DIRECT_BLUR;
+  }
+
+  // Blur (the recursive filter is only defined for sigma >= 0.5, and its
+  // border handling needs at least 3 pixels per side)
+  if ((method == R2_IMAGE_RECURSIVE_BLUR) && (sigma >= 0.5) && (width >= 3) && (height >= 3)) {
+    RecursiveGaussianBlur(plane, width, height, sigma, blurred);
+  }
+  else if (method == R2_IMAGE_BOX_BLUR) {
+    BoxGaussianBlur(plane, width, height, sigma, blurred);
+  }
+  else {
+    DirectGaussianBlur(plane, width, height, sigma, blurred);
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Gradients
+////////////////////////////////////////////////////////////////////////
+
+// Computes the Sobel gradient of pixels y0 <= y < y1 of column c (between
+//    columns l and r), with rows ym and yp above and below each y clamped to
+//    the plane, and optionally the structure tensor products
+template <int products>
+static inline void
+SobelSpan(const float *l, const float *c, const float *r, int y0, int y1, int height,
+  float *ix, float *iy, float *ixx, float *iyy, float *ixy)
+{
+  for (int y = y0; y < y1; y++) {
+    int ym = (y > 0) ? y - 1 : 0, yp = (y < height - 1) ? y + 1 : height - 1;
+    float gx = (r[ym] + 2 * r[y] + r[yp]) - (l[ym] + 2 * l[y] + l[yp]);
+    float gy = (l[yp] - l[ym]) + 2 * (c[yp] - c[ym]) + (r[yp] - r[ym]);
+    ix[y] = gx;
+    iy[y] = gy;
+    if (products) {
+      ixx[y] = gx * gx;
+      iyy[y] = gy * gy;
+      ixy[y] = gx * gy;
+    }
+  }
+}
+
+
+
+// Computes the gradients of whole columns, doing the first and last rows
+//    apart so the loop over the other rows needs no clamping and vectorizes
+template <int products>
+static void
+SobelColumns(const float *plane, int width, int height, float *ix, float *iy, float *ixx, float *iyy, float *ixy)
+{
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    for (int x = begin; x < end; x++) {
+      const float *l = plane + (size_t) std::max(x - 1, 0) * height;
+      const float *c = plane + (size_t) x * height;
+      const float *r = plane + (size_t) std::min(x + 1, width - 1) * height;
+      size_t offset = (size_t) x * height;
+      float *dx = ix + offset, *dy = iy + offset;
+      float *dxx = (products) ? ixx + offset : NULL;
+      float *dyy = (products) ? iyy + offset : NULL;
+      float *dxy = (products) ? ixy + offset : NULL;
+      int inner = std::max(height - 1, 1);
+      SobelSpan<products>(l, c, r, 0, 1, height, dx, dy, dxx, dyy, dxy);
+      for (int y = 1; y < inner; y++) {
+        float gx = (r[y-1] + 2 * r[y] + r[y+1]) - (l[y-1] + 2 * l[y] + l[y+1]);
+        float gy = (l[y+1] - l[y-1]) + 2 * (c[y+1] - c[y-1]) + (r[y+1] - r[y-1]);
+        dx[y] = gx;
+        dy[y] = gy;
+        if (products) {
+          dxx[y] = gx * gx;
+          dyy[y] = gy * gy;
+          dxy[y] = gx * gy;
+        }
+      }
+      SobelSpan<products>(l, c, r, inner, height, height, dx, dy, dxx, dyy, dxy);
+    }
+  });
+}
+
+
+
+void
+R2SobelGradients(const float *plane, int width, int height, float *ix, float *iy,
+  float *ixx, float *iyy, float *ixy)
+{
+  // Compute the products too if they are all asked for
+  if (ixx && iyy && ixy) SobelColumns<1>(plane, width, height, ix, iy, ixx, iyy, ixy);
+  else SobelColumns<0>(plane, width, height, ix, iy, NULL, NULL, NULL);
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Laplacian of Gaussian
+////////////////////////////////////////////////////////////////////////
+
+void
+R2LaplacianOfGaussian(const float *plane, int width, int height, double sigma, float *laplacian)
+{
+  // Filter from a copy in place, as the result is built in two passes
+  std::vector<float> copy;
+  if (laplacian == plane) {
+    copy.assign(plane, plane + (size_t) width * height);
+    plane = copy.data();
+  }
+
+  // Sum the second derivatives along x and along y, each a separable filter
+  std::vector<float> gaussian = FullKernel(R2GaussianKernel(sigma));
+  std::vector<float> second = FullKernel(R2GaussianKernel(sigma, 2));
+  int size = (int) gaussian.size();
+  R2ConvolveSeparable(plane, width, height, second.data(), size, gaussian.data(), size, laplacian);
+  R2ConvolveSeparable(plane, width, height, gaussian.data(), size, second.data(), size, laplacian,
+    R2_CONVOLVE_CLAMP_BORDER, 1);
+}
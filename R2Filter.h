@@ -0,0 +1,72 @@
+// Include file for linear filters on float planes
+#ifndef R2_FILTER_INCLUDED
+#define R2_FILTER_INCLUDED
+
+
+
+// Include files
+
+#include <vector>
+
+
+
+// Constant definitions
+
+// Gaussian kernels are truncated at this many standard deviations
+#define R2_FILTER_GAUSSIAN_CUTOFF 3.0
+
+// Automatic Gaussian blurs use the recursive filter from this sigma on
+#define R2_FILTER_RECURSIVE_SIGMA 4.0
+
+// Number of box filters approximating a Gaussian in box blurs
+#define R2_FILTER_BOX_PASSES 3
+
+
+
+// Function declarations
+
+// Fills one float plane per channel with the channels of an image, laid out
+// like its pixels (planes[k][x*height + y]), and back; per-pixel operations
+// may be applied to the pixels as they are read, in the same pass
+void R2ImageToPlanes(const R2Image& image, std::vector<float> planes[R2_IMAGE_NUM_CHANNELS],
+  const R2PixelOperations *operations = NULL);
+void R2PlanesToImage(const std::vector<float> planes[R2_IMAGE_NUM_CHANNELS], R2Image& image);
+
+// Fills a single plane of width * height floats with one channel of an image
+void R2ImageToPlane(const R2Image& image, int channel, float *plane);
+
+// Returns the normalized Gaussian kernel of standard deviation sigma, as its
+// radius + 1 taps (kernel[i] weights pixels at distance i), or with derivative
+// 2 the kernel of its second derivative (which sums to 0).  Kernels are
+// computed once per sigma and kept for the rest of the program
+const std::vector<float>& R2GaussianKernel(double sigma, int derivative = 0);
+
+// Blurs a width by height plane (plane[x*height + y]) with a Gaussian of
+// standard deviation sigma, repeating the border pixels; plane and blurred
+// may be the same.  The method is one of R2ImageBlurMethod: the direct blur
+// convolves with the sampled kernel, in time proportional to sigma, while
+// the recursive blur approximates the Gaussian with an IIR filter and the
+// box blur with R2_FILTER_BOX_PASSES box filters, whose costs do not depend
+// on sigma (the box blur averages over the plane only near its border)
+void R2GaussianBlur(const float *plane, int width, int height, double sigma, float *blurred,
+  int method = R2_IMAGE_AUTOMATIC_BLUR);
+
+// Computes the Laplacian of a plane blurred by a Gaussian of standard
+// deviation sigma, as the sum of two separable filters (second derivative of
+// the Gaussian along one axis, Gaussian along the other); multiply it by
+// sigma^2 to compare responses across scales.  plane and laplacian may be the same
+void R2LaplacianOfGaussian(const float *plane, int width, int height, double sigma, float *laplacian);
+
+// Computes the Sobel derivatives ix along x and iy along y of a plane (laid
+// out as above, repeating the border pixels) in one pass over it, and also the
+// structure tensor products ixx = ix^2, iyy = iy^2 and ixy = ix*iy if they are
+// all given.  The outputs are planes of the same size, separate from plane.
+// It serves the Harris detector, which needs both derivatives and their
+// products; R2Image::SobelX and SobelY, which need one derivative each, are
+// built on R2ConvolveSeparable instead
+void R2SobelGradients(const float *plane, int width, int height, float *ix, float *iy,
+  float *ixx = NULL, float *iyy = NULL, float *ixy = NULL);
+
+
+
+#endif
@@ -0,0 +1,543 @@
+// Source file for the homography class
+
+
+
+// Include files 
+
+#include "R2/R2.h"
+#include "R2Homography.h"
+#include "R2Parallel.h"
+#include <vector>
+#include <algorithm>
+#include <cfloat>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Homography estimation
+////////////////////////////////////////////////////////////////////////
+
+// Computes the similarity T that moves the centroid of the points to the
+//    origin and scales their mean distance from it to sqrt(2) (Hartley
+//    normalization), as T = [s 0 tx; 0 s ty; 0 0 1]
+static void 
+NormalizingTransform(const R2Point *points, int npoints, double& s, double& tx, double& ty)
+{
+  double cx = 0.0, cy = 0.0;
+  for (int i = 0; i < npoints; i++) {
+    cx += points[i].X();
+    cy += points[i].Y();
+  }
+  cx /= npoints;
+  cy /= npoints;
+
+  double dist = 0.0;
+  for (int i = 0; i < npoints; i++) {
+    double dx = points[i].X() - cx, dy = points[i].Y() - cy;
+    dist += sqrt(dx*dx + dy*dy);
+  }
+  dist /= npoints;
+
+  s = (dist > 0.0) ? sqrt(2.0) / dist : 1.0;
+  tx = -s * cx;
+  ty = -s * cy;
+}
+
+
+
+// Returns the normalizing transform as a matrix
+static R2Matrix<3, 3> 
+NormalizingMatrix(double s, double tx, double ty)
+{
+  const double t[3][3] = { { s, 0, tx }, { 0, s, ty }, { 0, 0, 1 } };
+  return R2Matrix<3, 3>(t);
+}
+
+
+
+// Returns the inverse of the normalizing transform as a matrix
+static R2Matrix<3, 3> 
+DenormalizingMatrix(double s, double tx, double ty)
+{
+  const double t[3][3] = { { 1/s, 0, -tx/s }, { 0, 1/s, -ty/s }, { 0, 0, 1 } };
+  return R2Matrix<3, 3>(t);
+}
+
+
+
+// Scales H so that H[2][2] = 1 (when it is not zero)
+static R2Homography 
+Canonical(const R2Matrix<3, 3>& H)
+{
+  R2Matrix<3, 3> result = H;
+  if (fabs(result[2][2]) > 1e-300) result *= 1.0 / result[2][2];
+  return R2Homography(result);
+}
+
+
+
+int 
+R2ComputeHomography(const R2Point from[4], const R2Point to[4], R2Homography& H)
+{
+  // Normalize both point sets, so the system below is well conditioned
+  double sf, txf, tyf, st, txt, tyt;
+  NormalizingTransform(from, 4, sf, txf, tyf);
+  NormalizingTransform(to, 4, st, txt, tyt);
+
+  double x[4], y[4], xp[4], yp[4];
+  for (int i = 0; i < 4; i++) {
+    x[i] = sf * from[i].X() + txf;
+    y[i] = sf * from[i].Y() + tyf;
+    xp[i] = st * to[i].X() + txt;
+    yp[i] = st * to[i].Y() + tyt;
+  }
+
+  // Reject configurations with three (nearly) collinear points on either side
+  for (int i = 0; i < 4; i++) {
+    int a = (i + 1) % 4, b = (i + 2) % 4, c = (i + 3) % 4;
+    if (fabs((x[b] - x[a]) * (y[c] - y[a]) - (y[b] - y[a]) * (x[c] - x[a])) < 1e-9) return 0;
+    if (fabs((xp[b] - xp[a]) * (yp[c] - yp[a]) - (yp[b] - yp[a]) * (xp[c] - xp[a])) < 1e-9) return 0;
+  }
+
+  // Build the 8x8 system A h = b for the normalized homography with h[8] = 1:
+  //    x' (h6 x + h7 y + 1) = h0 x + h1 y + h2
+  //    y' (h6 x + h7 y + 1) = h3 x + h4 y + h5
+  R2Matrix<8, 8> A;
+  R2Vec<8> b, h;
+  for (int i = 0; i < 4; i++) {
+    double *r1 = A[2*i], *r2 = A[2*i+1];
+    r1[0] = x[i]; r1[1] = y[i]; r1[2] = 1;
+    r1[6] = -x[i]*xp[i]; r1[7] = -y[i]*xp[i];
+    r2[3] = x[i]; r2[4] = y[i]; r2[5] = 1;
+    r2[6] = -x[i]*yp[i]; r2[7] = -y[i]*yp[i];
+    b(2*i) = xp[i];
+    b(2*i+1) = yp[i];
+  }
+  if (!R2Solve(A, b, h)) return 0;
+
+  // Undo the normalization: H = Tto^-1 Hn Tfrom
+  const double hn[3][3] = { { h(0), h(1), h(2) }, { h(3), h(4), h(5) }, { h(6), h(7), 1.0 } };
+  H = Canonical(DenormalizingMatrix(st, txt, tyt) * R2Matrix<3, 3>(hn) * NormalizingMatrix(sf, txf, tyf));
+  return 1;
+}
+
+
+
+int 
+R2FitHomography(const R2Point *from, const R2Point *to, int npoints, R2Homography& H, int refine_iterations)
+{
+  // Check arguments
+  if (npoints < 4) return 0;
+  if (npoints == 4 && refine_iterations <= 0) return R2ComputeHomography(from, to, H);
+
+  // Normalize both point sets
+  double sf, txf, tyf, st, txt, tyt;
+  NormalizingTransform(from, npoints, sf, txf, tyf);
+  NormalizingTransform(to, npoints, st, txt, tyt);
+
+  // Accumulate the normal equations A^T A of the DLT system, two rows per point
+  //    [ 0 0 0 -x -y -1  y'x  y'y  y' ]
+  //    [ x y 1  0  0  0 -x'x -x'y -x' ]
+  // without ever storing A
+  R2Matrix<9, 9> AtA;
+  for (int i = 0; i < npoints; i++) {
+    double x = sf * from[i].X() + txf, y = sf * from[i].Y() + tyf;
+    double xp = st * to[i].X() + txt, yp = st * to[i].Y() + tyt;
+    const double r1[9] = { 0, 0, 0, -x, -y, -1, yp*x, yp*y, yp };
+    const double r2[9] = { x, y, 1, 0, 0, 0, -xp*x, -xp*y, -xp };
+    for (int j = 0; j < 9; j++) {
+      for (int k = j; k < 9; k++) {
+        AtA[j][k] += r1[j] * r1[k] + r2[j] * r2[k];
+      }
+    }
+  }
+  for (int j = 0; j < 9; j++) 
+    for (int k = 0; k < j; k++) 
+      AtA[j][k] = AtA[k][j];
+
+  // The solution is the eigenvector of A^T A with the smallest eigenvalue
+  // (for a symmetric matrix its singular vectors are its eigenvectors)
+  R2Vec<9> w;
+  R2Matrix<9, 9> V;
+  R2SVD(AtA, w, V);
+  int smallest = 0, second = (w(0) <= w(1)) ? 1 : 0;
+  for (int j = 1; j < 9; j++) {
+    if (w(j) < w(smallest)) { second = smallest; smallest = j; }
+    else if (j != smallest && w(j) < w(second)) second = j;
+  }
+  double largest = 0;
+  for (int j = 0; j < 9; j++) largest = std::max(largest, w(j));
+  if (w(second) <= 1e-12 * largest) return 0;
+
+  // Undo the normalization
+  R2Matrix<3, 3> Hn;
+  for (int j = 0; j < 9; j++) Hn[j/3][j%3] = V[j][smallest];
+  R2Matrix<3, 3> result = DenormalizingMatrix(st, txt, tyt) * Hn * NormalizingMatrix(sf, txf, tyf);
+  if (fabs(R2Determinant(result)) < 1e-300) return 0;
+  H = Canonical(result);
+
+  // Refine with the reprojection error
+  if (refine_iterations > 0) R2RefineHomography(from, to, npoints, H, refine_iterations);
+
+  // Return success
+  return 1;
+}
+
+
+
+double 
+R2RefineHomography(const R2Point *from, const R2Point *to, int npoints, R2Homography& H, int max_iterations)
+{
+  // Check arguments
+  if (npoints <= 0) return 0.0;
+
+  // Work in normalized coordinates (errors are scaled by st, which does not
+  // change the minimum), with the 8 parameters h0..h7 of Hn and h8 = 1
+  double sf, txf, tyf, st, txt, tyt;
+  NormalizingTransform(from, npoints, sf, txf, tyf);
+  NormalizingTransform(to, npoints, st, txt, tyt);
+  R2Matrix<3, 3> Hn = NormalizingMatrix(st, txt, tyt) * H * DenormalizingMatrix(sf, txf, tyf);
+  if (fabs(Hn[2][2]) < 1e-300) return -1.0; // Degenerate: no error is defined
+  Hn *= 1.0 / Hn[2][2];
+
+  std::vector<double> x(npoints), y(npoints), xp(npoints), yp(npoints);
+  for (int i = 0; i < npoints; i++) {
+    x[i] = sf * from[i].X() + txf;
+    y[i] = sf * from[i].Y() + tyf;
+    xp[i] = st * to[i].X() + txt;
+    yp[i] = st * to[i].Y() + tyt;
+  }
+
+  // Sum of squared residuals for parameters h
+  auto Cost = [&](const R2Vec<8>& h) {
+    double cost = 0.0;
+    for (int i = 0; i < npoints; i++) {
+      double Z = h(6) * x[i] + h(7) * y[i] + 1.0;
+      double du = (h(0) * x[i] + h(1) * y[i] + h(2)) / Z - xp[i];
+      double dv = (h(3) * x[i] + h(4) * y[i] + h(5)) / Z - yp[i];
+      cost += du*du + dv*dv;
+    }
+    return cost;
+  };
+
+  R2Vec<8> h;
+  for (int j = 0; j < 8; j++) h(j) = Hn[j/3][j%3];
+  double cost = Cost(h);
+  double lambda = 1e-3;
+
+  for (int iter = 0; iter < max_iterations; iter++) {
+    // Accumulate J^T J and J^T r with the analytical Jacobian of
+    //    u = (h0 x + h1 y + h2) / Z, v = (h3 x + h4 y + h5) / Z, Z = h6 x + h7 y + 1
+    R2Matrix<8, 8> JtJ;
+    R2Vec<8> Jtr;
+    for (int i = 0; i < npoints; i++) {
+      double iz = 1.0 / (h(6) * x[i] + h(7) * y[i] + 1.0);
+      double u = (h(0) * x[i] + h(1) * y[i] + h(2)) * iz;
+      double v = (h(3) * x[i] + h(4) * y[i] + h(5)) * iz;
+      const double ju[8] = { x[i]*iz, y[i]*iz, iz, 0, 0, 0, -u*x[i]*iz, -u*y[i]*iz };
+      const double jv[8] = { 0, 0, 0, x[i]*iz, y[i]*iz, iz, -v*x[i]*iz, -v*y[i]*iz };
+      double du = u - xp[i], dv = v - yp[i];
+      for (int j = 0; j < 8; j++) {
+        Jtr(j) += ju[j] * du + jv[j] * dv;
+        for (int k = j; k < 8; k++) JtJ[j][k] += ju[j] * ju[k] + jv[j] * jv[k];
+      }
+    }
+    for (int j = 0; j < 8; j++) 
+      for (int k = 0; k < j; k++) 
+        JtJ[j][k] = JtJ[k][j];
+
+    // Try damped steps until one decreases the cost
+    bool improved = false, converged = false;
+    while (!improved && lambda < 1e10) {
+      R2Matrix<8, 8> A = JtJ;
+      for (int j = 0; j < 8; j++) A[j][j] += lambda * (JtJ[j][j] + 1e-12);
+      R2Vec<8> step;
+      if (R2Solve(A, Jtr * -1.0, step)) {
+        double newcost = Cost(h + step);
+        if (newcost < cost) {
+          improved = true;
+          h += step;
+          lambda = (lambda > 1e-12) ? 0.1 * lambda : lambda;
+          converged = (cost - newcost < 1e-12 * cost);
+          cost = newcost;
+          break;
+        }
+      }
+      lambda *= 10.0;
+    }
+    if (!improved || converged) break;
+  }
+
+  // Convert back to image coordinates
+  for (int j = 0; j < 8; j++) Hn[j/3][j%3] = h(j);
+  Hn[2][2] = 1.0;
+  H = Canonical(DenormalizingMatrix(st, txt, tyt) * Hn * NormalizingMatrix(sf, txf, tyf));
+
+  // Return RMS reprojection error in pixels
+  return sqrt(cost / npoints) / st;
+}
+
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Robust estimation
+////////////////////////////////////////////////////////////////////////
+
+// Number of hypotheses generated between two checks of the stopping criterion
+#define RANSAC_ROUND_HYPOTHESES 64
+
+// Number of partial sums kept while scoring a hypothesis
+#define RANSAC_SCORE_LANES 4
+
+// Number of times the final model is refitted on its own inliers
+#define RANSAC_REFIT_PASSES 2
+
+
+
+// Correspondences in separate coordinate arrays, so scoring streams through memory
+struct R2HomographyData {
+  std::vector<double> x, y, xp, yp;
+};
+
+
+
+// A hypothesis and its score
+struct R2HomographyHypothesis {
+  R2Homography H;
+  double cost;
+  int ninliers;
+};
+
+
+
+// Returns a pseudo random number that only depends on seed (splitmix64), so every
+// hypothesis draws the same sample regardless of which thread evaluates it
+static unsigned long long 
+HashRandom(unsigned long long seed)
+{
+  unsigned long long z = seed + 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+
+// Draws count distinct indices in [0, n) for hypothesis number k
+static void 
+DrawSample(int k, int n, int count, int *sample)
+{
+  unsigned long long state = (unsigned long long) k * RANSAC_ROUND_HYPOTHESES;
+  for (int i = 0; i < count; i++) {
+    int index;
+    bool repeated;
+    do {
+      index = (int) (HashRandom(state++) % (unsigned long long) n);
+      repeated = false;
+      for (int j = 0; j < i; j++) if (sample[j] == index) repeated = true;
+    } while (repeated);
+    sample[i] = index;
+  }
+}
+
+
+
+// Scores H by its truncated squared reprojection error (MSAC), which ranks
+// hypotheses with the same number of inliers by how well they fit them.  The
+// sums are kept in RANSAC_SCORE_LANES independent partial sums, so the compiler
+// can vectorize the loop without reordering floating point additions
+static void 
+ScoreHypothesis(const R2HomographyData& data, double threshold2, R2HomographyHypothesis& hypothesis)
+{
+  const R2Homography& H = hypothesis.H;
+  const double h0 = H[0][0], h1 = H[0][1], h2 = H[0][2];
+  const double h3 = H[1][0], h4 = H[1][1], h5 = H[1][2];
+  const double h6 = H[2][0], h7 = H[2][1], h8 = H[2][2];
+  const double *x = data.x.data(), *y = data.y.data();
+  const double *xp = data.xp.data(), *yp = data.yp.data();
+  const int n = (int) data.x.size();
+
+  double cost[RANSAC_SCORE_LANES] = { 0 }, count[RANSAC_SCORE_LANES] = { 0 };
+  int i = 0;
+  for ( ; i + RANSAC_SCORE_LANES <= n; i += RANSAC_SCORE_LANES) {
+    for (int j = 0; j < RANSAC_SCORE_LANES; j++) {
+      double iz = 1.0 / (h6 * x[i+j] + h7 * y[i+j] + h8);
+      double du = (h0 * x[i+j] + h1 * y[i+j] + h2) * iz - xp[i+j];
+      double dv = (h3 * x[i+j] + h4 * y[i+j] + h5) * iz - yp[i+j];
+      double e2 = du*du + dv*dv;
+      double truncated = (e2 < threshold2) ? e2 : threshold2;
+      count[j] += (e2 < threshold2) ? 1.0 : 0.0;
+      cost[j] += truncated;
+    }
+  }
+  for ( ; i < n; i++) {
+    double iz = 1.0 / (h6 * x[i] + h7 * y[i] + h8);
+    double du = (h0 * x[i] + h1 * y[i] + h2) * iz - xp[i];
+    double dv = (h3 * x[i] + h4 * y[i] + h5) * iz - yp[i];
+    double e2 = du*du + dv*dv;
+    cost[0] += (e2 < threshold2) ? e2 : threshold2;
+    count[0] += (e2 < threshold2) ? 1.0 : 0.0;
+  }
+
+  hypothesis.cost = 0.0;
+  hypothesis.ninliers = 0;
+  for (int j = 0; j < RANSAC_SCORE_LANES; j++) {
+    hypothesis.cost += cost[j];
+    hypothesis.ninliers += (int) count[j];
+  }
+}
+
+
+
+// Fills schedule[n] with the number of hypotheses after which PROSAC samples from
+// the n best correspondences, so that after max_iterations it samples from all
+static void 
+ProsacSchedule(int npoints, int max_iterations, std::vector<int>& schedule)
+{
+  // T_n is the expected number of samples drawn only from the n best points
+  // among max_iterations drawn uniformly from all of them
+  schedule.assign(npoints + 1, 0);
+  double Tn = max_iterations;
+  for (int i = 0; i < 4; i++) Tn *= (double) (4 - i) / (npoints - i);
+  int Tprime = 1;
+  for (int n = 4; n <= npoints; n++) {
+    schedule[n] = Tprime;
+    double Tnext = Tn * (n + 1) / (n + 1 - 4);
+    Tprime += (int) ceil(Tnext - Tn);
+    Tn = Tnext;
+  }
+}
+
+
+
+// Returns the number of hypotheses needed to draw one all-inlier sample with the
+// given confidence when a fraction w of the correspondences are inliers
+static int 
+RequiredIterations(double w, double confidence, int max_iterations)
+{
+  double w4 = w * w * w * w;
+  if (w4 >= 1.0) return 1;
+  if (w4 <= 0.0) return max_iterations;
+  double k = log(1.0 - confidence) / log(1.0 - w4);
+  return (k < max_iterations) ? (int) ceil(k) : max_iterations;
+}
+
+
+
+int 
+R2EstimateHomography(const R2Point *from, const R2Point *to, int npoints, R2Homography& H,
+  double threshold, int sorted, int *inliers, int max_iterations, double confidence)
+{
+  // Check arguments
+  if (npoints < 4) return 0;
+  if (max_iterations < 1) max_iterations = 1;
+  const double threshold2 = threshold * threshold;
+
+  // Copy the correspondences into separate arrays
+  R2HomographyData data;
+  data.x.resize(npoints); data.y.resize(npoints);
+  data.xp.resize(npoints); data.yp.resize(npoints);
+  for (int i = 0; i < npoints; i++) {
+    data.x[i] = from[i].X(); data.y[i] = from[i].Y();
+    data.xp[i] = to[i].X(); data.yp[i] = to[i].Y();
+  }
+
+  // Precompute the PROSAC growth of the sampling set
+  std::vector<int> schedule;
+  if (sorted) ProsacSchedule(npoints, max_iterations, schedule);
+
+  // Generate and score hypotheses a round at a time, spreading each round over
+  // the worker threads, until the best model is found with enough confidence
+  R2HomographyHypothesis best;
+  best.cost = DBL_MAX;
+  best.ninliers = 0;
+  std::vector<R2HomographyHypothesis> round(RANSAC_ROUND_HYPOTHESES);
+  int required = max_iterations;
+  int k = 0;
+  while (k < required) {
+    int count = std::min(RANSAC_ROUND_HYPOTHESES, required - k);
+    R2ParallelFor(0, count, R2NumThreads(), [&](int begin, int end) {
+      for (int j = begin; j < end; j++) {
+        R2HomographyHypothesis& hypothesis = round[j];
+        hypothesis.ninliers = 0;
+        hypothesis.cost = DBL_MAX;
+
+        // Draw a minimal sample: uniformly, or for PROSAC the newest point of the
+        // growing set together with three of the better ones
+        int sample[4];
+        int t = k + j;
+        if (sorted) {
+          int n = (int) (std::upper_bound(schedule.begin() + 5, schedule.end(), t + 1) - schedule.begin()) - 1;
+          DrawSample(t, n - 1, 3, sample);
+          sample[3] = n - 1;
+        }
+        else {
+          DrawSample(t, npoints, 4, sample);
+        }
+
+        // Solve and score it
+        R2Point f[4], p[4];
+        for (int i = 0; i < 4; i++) {
+          f[i] = from[sample[i]];
+          p[i] = to[sample[i]];
+        }
+        if (!R2ComputeHomography(f, p, hypothesis.H)) continue;
+        ScoreHypothesis(data, threshold2, hypothesis);
+      }
+    });
+
+    // Keep the best hypothesis of the round, and update the stopping criterion
+    for (int j = 0; j < count; j++) {
+      if (round[j].ninliers >= 4 && round[j].cost < best.cost) best = round[j];
+    }
+    k += count;
+    if (best.ninliers > 0) {
+      // With PROSAC, the hypotheses were drawn from the nsampled best points, so
+      // the inlier ratio that matters is the one among those
+      double w = (double) best.ninliers / npoints;
+      if (sorted) {
+        int nsampled = (int) (std::upper_bound(schedule.begin() + 5, schedule.end(), k) - schedule.begin()) - 1;
+        int ngood = 0;
+        for (int i = 0; i < nsampled; i++) {
+          if (R2Distance(best.H.Transform(from[i]), to[i]) < threshold) ngood++;
+        }
+        w = std::max(w, (double) ngood / nsampled);
+      }
+      int needed = RequiredIterations(w, confidence, max_iterations);
+      required = std::min(required, needed);
+    }
+  }
+
+  // Check that a model was found
+  if (best.ninliers < 4) return 0;
+
+  // Refit on all inliers of the best model, then on the inliers of the refit
+  std::vector<R2Point> fin, tin;
+  for (int pass = 0; pass < RANSAC_REFIT_PASSES; pass++) {
+    fin.clear();
+    tin.clear();
+    for (int i = 0; i < npoints; i++) {
+      if (R2Distance(best.H.Transform(from[i]), to[i]) < threshold) {
+        fin.push_back(from[i]);
+        tin.push_back(to[i]);
+      }
+    }
+    R2HomographyHypothesis refit;
+    if ((fin.size() < 4) || !R2FitHomography(fin.data(), tin.data(), (int) fin.size(), refit.H, 5)) break;
+    ScoreHypothesis(data, threshold2, refit);
+    if (refit.ninliers < best.ninliers) break;
+    best = refit;
+  }
+
+  // Fill in the inlier flags
+  if (inliers) {
+    for (int i = 0; i < npoints; i++) {
+      inliers[i] = (R2Distance(best.H.Transform(from[i]), to[i]) < threshold) ? 1 : 0;
+    }
+  }
+
+  // Return the model and its support
+  H = best.H;
+  return best.ninliers;
+}
@@ -0,0 +1,100 @@
+// Include file for the homography class
+#ifndef R2_HOMOGRAPHY_INCLUDED
+#define R2_HOMOGRAPHY_INCLUDED
+
+
+
+// Include files
+
+#include "R2Matrix.h"
+
+
+
+// Class definition
+
+class R2Homography : public R2Matrix<3, 3, double> {
+ public:
+  // Constructors
+  R2Homography(void);
+  R2Homography(const R2Matrix<3, 3, double>& matrix);
+
+  // Point mapping: x' ~ H x, in homogeneous coordinates
+  R2Point Transform(const R2Point& point) const;
+  R2Homography Inverse(void) const;
+};
+
+
+
+// Function declarations
+
+// Computes the homography that maps each of the four "from" points onto the
+// corresponding "to" point; returns 0 (and leaves H unchanged) if three of the
+// points are collinear
+int R2ComputeHomography(const R2Point from[4], const R2Point to[4], R2Homography& H);
+
+// Computes the homography that best maps npoints >= 4 "from" points onto the
+// corresponding "to" points in the least squares sense (normalized DLT), then
+// optionally refines it by minimizing the reprojection error in the "to" image;
+// returns 0 (and leaves H unchanged) if the points do not determine a homography
+int R2FitHomography(const R2Point *from, const R2Point *to, int npoints, R2Homography& H, int refine_iterations = 0);
+
+// Refines H by Levenberg-Marquardt minimization of the sum of squared distances
+// between H from[i] and to[i]; returns the final RMS reprojection error (0 for
+// no points), or -1 (leaving H unchanged) if H is degenerate, mapping the
+// centroid of the "from" points to infinity
+double R2RefineHomography(const R2Point *from, const R2Point *to, int npoints, R2Homography& H, int max_iterations = 10);
+
+// Robustly estimates the homography mapping from[i] onto to[i] when some of the
+// correspondences are wrong (RANSAC on 4-point hypotheses evaluated in parallel,
+// stopping once the best model is found with the given confidence, then refitted
+// on all of its inliers).  Correspondences are inliers if they are mapped within
+// threshold pixels of their target.  If sorted is set, the correspondences are
+// assumed to be ordered from most to least reliable and hypotheses are first drawn
+// from the best ones (PROSAC).  Returns the number of inliers (0 on failure), and
+// optionally fills inliers[i] with 1 for inliers and 0 for outliers
+int R2EstimateHomography(const R2Point *from, const R2Point *to, int npoints, R2Homography& H,
+  double threshold = 3.0, int sorted = 0, int *inliers = 0,
+  int max_iterations = 2000, double confidence = 0.995);
+
+
+
+// Inline functions
+
+inline R2Homography::
+R2Homography(void)
+  : R2Matrix<3, 3, double>(R2Matrix<3, 3, double>::Identity())
+{
+}
+
+
+
+inline R2Homography::
+R2Homography(const R2Matrix<3, 3, double>& matrix)
+  : R2Matrix<3, 3, double>(matrix)
+{
+}
+
+
+
+inline R2Point R2Homography::
+Transform(const R2Point& point) const
+{
+  // Return point mapped through the homography
+  double x = m[0][0] * point.X() + m[0][1] * point.Y() + m[0][2];
+  double y = m[1][0] * point.X() + m[1][1] * point.Y() + m[1][2];
+  double z = m[2][0] * point.X() + m[2][1] * point.Y() + m[2][2];
+  return R2Point(x / z, y / z);
+}
+
+
+
+inline R2Homography R2Homography::
+Inverse(void) const
+{
+  // Return homography mapping the other way
+  return R2Homography(R2Inverse(*this));
+}
+
+
+
+#endif
@@ -7,11 +7,21 @@
 #include "R2/R2.h"
 #include "R2Pixel.h"
 #include "R2Image.h"
-#include "svd.h"
+#include "R2ImagePyramid.h"
+#include "R2Matrix.h"
+#include "R2Homography.h"
+#include "R2Registration.h"
+#include "R2Feature.h"
+#include "R2Filter.h"
+#include "R2Convolve.h"
+#include "R2PixelOperations.h"
+#include "R2ScaleSpace.h"
+#include "R2Parallel.h"
 #include <vector>
 #include "math.h"
 #include <cmath>
 #include <cfloat>
+#include <algorithm>
 
 
 
@@ -139,346 +149,447 @@ svdTest(void)
 	R2Point p5(-0.2,4.2);
 
 	// build the 5x6 matrix of equations
-	double** linEquations = dmatrix(1,5,1,6);
-
-	linEquations[1][1] = p1[0]*p1[0];
-	linEquations[1][2] = p1[0]*p1[1];
-	linEquations[1][3] = p1[1]*p1[1];
-	linEquations[1][4] = p1[0];
-	linEquations[1][5] = p1[1];
-	linEquations[1][6] = 1.0;
-
-	linEquations[2][1] = p2[0]*p2[0];
-	linEquations[2][2] = p2[0]*p2[1];
-	linEquations[2][3] = p2[1]*p2[1];
-	linEquations[2][4] = p2[0];
-	linEquations[2][5] = p2[1];
-	linEquations[2][6] = 1.0;
-
-	linEquations[3][1] = p3[0]*p3[0];
-	linEquations[3][2] = p3[0]*p3[1];
-	linEquations[3][3] = p3[1]*p3[1];
-	linEquations[3][4] = p3[0];
-	linEquations[3][5] = p3[1];
-	linEquations[3][6] = 1.0;
-	
-	linEquations[4][1] = p4[0]*p4[0];
-	linEquations[4][2] = p4[0]*p4[1];
-	linEquations[4][3] = p4[1]*p4[1];
-	linEquations[4][4] = p4[0];
-	linEquations[4][5] = p4[1];
-	linEquations[4][6] = 1.0;
-
-	linEquations[5][1] = p5[0]*p5[0];
-	linEquations[5][2] = p5[0]*p5[1];
-	linEquations[5][3] = p5[1]*p5[1];
-	linEquations[5][4] = p5[0];
-	linEquations[5][5] = p5[1];
-	linEquations[5][6] = 1.0;
+	R2Point points[5] = { p1, p2, p3, p4, p5 };
+	R2Matrix<5,6> linEquations;
+	for (int i = 0; i < 5; i++) {
+		linEquations[i][0] = points[i][0]*points[i][0];
+		linEquations[i][1] = points[i][0]*points[i][1];
+		linEquations[i][2] = points[i][1]*points[i][1];
+		linEquations[i][3] = points[i][0];
+		linEquations[i][4] = points[i][1];
+		linEquations[i][5] = 1.0;
+	}
 
 	printf("\n Fitting a conic to five points:\n");
-	printf("Point #1: %f,%f\n",p1[0],p1[1]);
-	printf("Point #2: %f,%f\n",p2[0],p2[1]);
-	printf("Point #3: %f,%f\n",p3[0],p3[1]);
-	printf("Point #4: %f,%f\n",p4[0],p4[1]);
-	printf("Point #5: %f,%f\n",p5[0],p5[1]);
+	for (int i = 0; i < 5; i++) printf("Point #%d: %f,%f\n",i+1,points[i][0],points[i][1]);
 
 	// compute the SVD
-	double singularValues[7]; // 1..6
-	double** nullspaceMatrix = dmatrix(1,6,1,6);
-	svdcmp(linEquations, 5, 6, singularValues, nullspaceMatrix);
+	R2Vec<6> singularValues;
+	R2Matrix<6,6> nullspaceMatrix;
+	R2SVD(linEquations, singularValues, nullspaceMatrix);
 
 	// get the result
-	printf("\n Singular values: %f, %f, %f, %f, %f, %f\n",singularValues[1],singularValues[2],singularValues[3],singularValues[4],singularValues[5],singularValues[6]);
+	printf("\n Singular values: %f, %f, %f, %f, %f, %f\n",singularValues(0),singularValues(1),singularValues(2),singularValues(3),singularValues(4),singularValues(5));
 
 	// find the smallest singular value:
-	int smallestIndex = 1;
-	for(int i=2;i<7;i++) if(singularValues[i]<singularValues[smallestIndex]) smallestIndex=i;
+	int smallestIndex = 0;
+	for(int i=1;i<6;i++) if(singularValues(i)<singularValues(smallestIndex)) smallestIndex=i;
 
 	// solution is the nullspace of the matrix, which is the column in V corresponding to the smallest singular value (which should be 0)
-	printf("Conic coefficients: %f, %f, %f, %f, %f, %f\n",nullspaceMatrix[1][smallestIndex],nullspaceMatrix[2][smallestIndex],nullspaceMatrix[3][smallestIndex],nullspaceMatrix[4][smallestIndex],nullspaceMatrix[5][smallestIndex],nullspaceMatrix[6][smallestIndex]);
+	R2Vec<6> conic;
+	for (int i = 0; i < 6; i++) conic(i) = nullspaceMatrix[i][smallestIndex];
+	printf("Conic coefficients: %f, %f, %f, %f, %f, %f\n",conic(0),conic(1),conic(2),conic(3),conic(4),conic(5));
 
 	// make sure the solution is correct:
-	printf("Equation #1 result: %f\n",	p1[0]*p1[0]*nullspaceMatrix[1][smallestIndex] + 
-										p1[0]*p1[1]*nullspaceMatrix[2][smallestIndex] + 
-										p1[1]*p1[1]*nullspaceMatrix[3][smallestIndex] + 
-										p1[0]*nullspaceMatrix[4][smallestIndex] + 
-										p1[1]*nullspaceMatrix[5][smallestIndex] + 
-										nullspaceMatrix[6][smallestIndex]);
-
-	printf("Equation #2 result: %f\n",	p2[0]*p2[0]*nullspaceMatrix[1][smallestIndex] + 
-										p2[0]*p2[1]*nullspaceMatrix[2][smallestIndex] + 
-										p2[1]*p2[1]*nullspaceMatrix[3][smallestIndex] + 
-										p2[0]*nullspaceMatrix[4][smallestIndex] + 
-										p2[1]*nullspaceMatrix[5][smallestIndex] + 
-										nullspaceMatrix[6][smallestIndex]);
-
-	printf("Equation #3 result: %f\n",	p3[0]*p3[0]*nullspaceMatrix[1][smallestIndex] + 
-										p3[0]*p3[1]*nullspaceMatrix[2][smallestIndex] + 
-										p3[1]*p3[1]*nullspaceMatrix[3][smallestIndex] + 
-										p3[0]*nullspaceMatrix[4][smallestIndex] + 
-										p3[1]*nullspaceMatrix[5][smallestIndex] + 
-										nullspaceMatrix[6][smallestIndex]);
-
-	printf("Equation #4 result: %f\n",	p4[0]*p4[0]*nullspaceMatrix[1][smallestIndex] + 
-										p4[0]*p4[1]*nullspaceMatrix[2][smallestIndex] + 
-										p4[1]*p4[1]*nullspaceMatrix[3][smallestIndex] + 
-										p4[0]*nullspaceMatrix[4][smallestIndex] + 
-										p4[1]*nullspaceMatrix[5][smallestIndex] + 
-										nullspaceMatrix[6][smallestIndex]);
-
-	printf("Equation #5 result: %f\n",	p5[0]*p5[0]*nullspaceMatrix[1][smallestIndex] + 
-										p5[0]*p5[1]*nullspaceMatrix[2][smallestIndex] + 
-										p5[1]*p5[1]*nullspaceMatrix[3][smallestIndex] + 
-										p5[0]*nullspaceMatrix[4][smallestIndex] + 
-										p5[1]*nullspaceMatrix[5][smallestIndex] + 
-										nullspaceMatrix[6][smallestIndex]);
+	for (int i = 0; i < 5; i++) {
+		R2Vec<6> equation;
+		for (int j = 0; j < 6; j++) equation(j) = linEquations[i][j];
+		printf("Equation #%d result: %f\n", i+1, R2Dot(equation, conic));
+	}
 
 	R2Point test_point(0.34,-2.8);
+	const double offConic[1][6] = { { test_point[0]*test_point[0], test_point[0]*test_point[1], test_point[1]*test_point[1], test_point[0], test_point[1], 1.0 } };
 
-	printf("A point off the conic: %f\n",	test_point[0]*test_point[0]*nullspaceMatrix[1][smallestIndex] + 
-											test_point[0]*test_point[1]*nullspaceMatrix[2][smallestIndex] + 
-											test_point[1]*test_point[1]*nullspaceMatrix[3][smallestIndex] + 
-											test_point[0]*nullspaceMatrix[4][smallestIndex] + 
-											test_point[1]*nullspaceMatrix[5][smallestIndex] + 
-											nullspaceMatrix[6][smallestIndex]);
+	printf("A point off the conic: %f\n", R2Dot(R2Vec<6>(offConic), conic));
 
 	return;	
 }
 
 
+////////////////////////////////////////////////////////////////////////
+// Sampling
+////////////////////////////////////////////////////////////////////////
+
+// Filter weights are tabulated for fractional positions quantized to
+//    1/SAMPLE_PHASES of a pixel, so the samplers never evaluate exp()
+#define SAMPLE_PHASES 64
+#define SAMPLE_GAUSSIAN_SIGMA 0.6
+
+
+// Weights of the 4 Gaussian taps at offsets -1, 0, 1, 2 from floor(u), one row
+//    per fractional phase of u (normalized to sum to one)
+struct R2GaussianSampleTable {
+  double w[SAMPLE_PHASES + 1][4];
+
+  R2GaussianSampleTable(void) {
+    for (int p = 0; p <= SAMPLE_PHASES; p++) {
+      double f = (double) p / SAMPLE_PHASES, sum = 0.0;
+      for (int t = 0; t < 4; t++) {
+        double d = (t - 1) - f;
+        w[p][t] = exp(-d*d / (2.0 * SAMPLE_GAUSSIAN_SIGMA * SAMPLE_GAUSSIAN_SIGMA));
+        sum += w[p][t];
+      }
+      for (int t = 0; t < 4; t++) w[p][t] /= sum;
+    }
+  }
+};
+
+
+static const R2GaussianSampleTable& GaussianSampleTable(void) {
+  // built once, on first use
+  static const R2GaussianSampleTable table;
+  return table;
+}
+
+
+// Clamps a sample index to [0, n-1], so lookups outside the image repeat its border
+static inline int ClampIndex(int i, int n) {
+  return (i < 0) ? 0 : ((i >= n) ? n - 1 : i);
+}
+
+
+// Splits a sample coordinate into its integer pixel and quantized fractional phase
+static inline int SamplePhase(double u, int& i) {
+  double fu = floor(u);
+  i = (int) fu;
+  return (int) ((u - fu) * SAMPLE_PHASES + 0.5);
+}
+
+
+static inline R2Pixel SamplePoint(const R2Image& image, double u, double v) {
+  // nearest pixel center (pixel centers are at integer coordinates, as for the
+  //    bilinear and Gaussian samplers and the pyramid levels)
+  int x = ClampIndex((int) floor(u + 0.5), image.Width());
+  int y = ClampIndex((int) floor(v + 0.5), image.Height());
+  return image[x][y];
+}
+
+
+static inline R2Pixel SampleBilinear(const R2Image& image, double u, double v) {
+  int x, y;
+  double fx = (double) SamplePhase(u, x) / SAMPLE_PHASES;
+  double fy = (double) SamplePhase(v, y) / SAMPLE_PHASES;
+  int x0 = ClampIndex(x, image.Width()), x1 = ClampIndex(x + 1, image.Width());
+  int y0 = ClampIndex(y, image.Height()), y1 = ClampIndex(y + 1, image.Height());
+  const R2Pixel *row0 = image[x0], *row1 = image[x1];
+
+  double w00 = (1 - fx) * (1 - fy), w01 = (1 - fx) * fy, w10 = fx * (1 - fy), w11 = fx * fy;
+  double c[4];
+  for (int k = 0; k < 4; k++) {
+    c[k] = w00 * row0[y0][k] + w01 * row0[y1][k] + w10 * row1[y0][k] + w11 * row1[y1][k];
+  }
+  return R2Pixel(c);
+}
+
+
+static inline R2Pixel SampleGaussian(const R2Image& image, double u, double v) {
+  int x, y;
+  const R2GaussianSampleTable& table = GaussianSampleTable();
+  const double *wx = table.w[SamplePhase(u, x)];
+  const double *wy = table.w[SamplePhase(v, y)];
+
+  int ys[4];
+  for (int t = 0; t < 4; t++) ys[t] = ClampIndex(y - 1 + t, image.Height());
+
+  double c[4] = { 0.0, 0.0, 0.0, 0.0 };
+  for (int s = 0; s < 4; s++) {
+    const R2Pixel *row = image[ClampIndex(x - 1 + s, image.Width())];
+    for (int t = 0; t < 4; t++) {
+      double w = wx[s] * wy[t];
+      for (int k = 0; k < 4; k++) c[k] += w * row[ys[t]][k];
+    }
+  }
+  return R2Pixel(c);
+}
+
+
+// Samples with a sampling method fixed at compile time
+template <int sampling_method>
+static inline R2Pixel SampleImage(const R2Image& image, double u, double v) {
+  switch (sampling_method) {
+  case R2_IMAGE_BILINEAR_SAMPLING: return SampleBilinear(image, u, v);
+  case R2_IMAGE_GAUSSIAN_SAMPLING: return SampleGaussian(image, u, v);
+  default: return SamplePoint(image, u, v);
+  }
+}
+
+
+// Samples a pyramid at level of detail 'lod' (log2 of the footprint of a pixel in
+//    level 0 pixels): point sampling takes the nearest level, the filtered
+//    methods blend the two levels around lod (trilinear filtering)
+template <int sampling_method>
+static inline R2Pixel SamplePyramid(const R2ImagePyramid& pyramid, double u, double v, double lod) {
+  if (lod <= 0.0 || pyramid.NLevels() == 1) return SampleImage<sampling_method>(pyramid.Level(0), u, v);
+  if (lod > pyramid.NLevels() - 1) lod = pyramid.NLevels() - 1;
+
+  if (sampling_method == R2_IMAGE_POINT_SAMPLING) {
+    int level = (int) (lod + 0.5);
+    return SamplePoint(pyramid.Level(level), pyramid.ToLevel(u, level), pyramid.ToLevel(v, level));
+  }
+
+  int level0 = (int) lod;
+  int level1 = (level0 + 1 < pyramid.NLevels()) ? level0 + 1 : level0;
+  double t = lod - level0;
+  R2Pixel p0 = SampleImage<sampling_method>(pyramid.Level(level0), pyramid.ToLevel(u, level0), pyramid.ToLevel(v, level0));
+  if (t == 0.0 || level1 == level0) return p0;
+  R2Pixel p1 = SampleImage<sampling_method>(pyramid.Level(level1), pyramid.ToLevel(u, level1), pyramid.ToLevel(v, level1));
+  double c[4];
+  for (int k = 0; k < 4; k++) c[k] = (1.0 - t) * p0[k] + t * p1[k];
+  return R2Pixel(c);
+}
+
+
+R2Pixel R2Image::
+Sample(double u, double v, int sampling_method) const
+{
+  // Return the image value at (u, v), with pixel centers at integer coordinates
+  // and the border repeated outside the image
+  switch (sampling_method) {
+  case R2_IMAGE_BILINEAR_SAMPLING: return SampleImage<R2_IMAGE_BILINEAR_SAMPLING>(*this, u, v);
+  case R2_IMAGE_GAUSSIAN_SAMPLING: return SampleImage<R2_IMAGE_GAUSSIAN_SAMPLING>(*this, u, v);
+  default: return SampleImage<R2_IMAGE_POINT_SAMPLING>(*this, u, v);
+  }
+}
+
+
 /////////////////////////////////////////////////////////////////////////
 ////////////////////// FUNCTIONS FOR MAGIC FRAME ////////////////////////
 /////////////////////////////////////////////////////////////////////////
 
-void R2Image::mapFramePixels(R2Image * freezeFrame, Point origCorners[4], Point curCorners[4]) {
+void R2Image::mapFramePixels(const R2ImagePyramid * freezePyramid, R2Point origCorners[4], R2Point curCorners[4], int sampling_method) {
    
   //  1) detect 4 corners in "this" image translated from previous
   detectLocalCorners(curCorners);
   //  2) create H homography matrix from the point correspondences of the corners
-  double ** model = DLT(curCorners, origCorners);
+  R2Homography model;
+  if (!DLT(curCorners, origCorners, model)) {
+    fprintf(stderr, "Unable to compute homography from degenerate frame corners\n");
+    return;
+  }
   //  3) map all points within the frozen image to their locations (Hx = x')
   //      in "this" image and overwrite the pixels with the frozen image pixels
-  inverseWarp(freezeFrame, curCorners, model);
+  inverseWarp(freezePyramid, curCorners, model, sampling_method);
 }
 
-void R2Image::inverseWarp(R2Image * freezeFrame, Point curCorners[4], double ** model) {
-	// figure out orientation of rectangle -- use fact that farthest corner from a given corner is the diagonal
-	Point pt1 = curCorners[0];
-	double dist1 = 9999999.9, dist2 = 9999999.9, dist3 = 9999999.9;
-	int ind1, ind2, ind3;
-	for (int j = 1; j < 4; j++) {
-		double dist = sqrt(pow(pt1.x - curCorners[j].x,2) + pow(pt1.y - curCorners[j].y,2));
-		if (dist < dist1) {
-			dist3 = dist2;
-			dist2 = dist1;
-			dist1 = dist;
-			ind3 = ind2;
-			ind2 = ind1;
-			ind1 = j;
-		} else if (dist < dist2) {
-			dist3 = dist2;
-			dist2 = dist;
-			ind3 = ind2;
-			ind2 = j;
-		} else {
-			dist3 = dist;
-			ind3 = j;
-		}
-	}
-	// now create corners array that has the corners in order of going around the rectangle
-	Point corners[4];
-	corners[0] = pt1;
-	corners[1] = curCorners[ind1];
-	corners[2] = curCorners[ind3];
-	corners[3] = curCorners[ind2];
-
-	// create equations for borders of rectangle
-	double m12 = 0.0,m23 = 0.0,m34 = 0.0,m41 = 0.0,b12 = 0.0,b23 = 0.0,b34 = 0.0,b41 = 0.0;
-	if (corners[1].x == corners[0].x) {
-		corners[1].x = corners[1].x + 1;
-	}
-	m12 = ((double)corners[1].y - corners[0].y) / ((double)corners[1].x - corners[0].x);
-	b12 = corners[1].y - (m12 * corners[1].x);
-	if (corners[2].x == corners[1].x) {
-		corners[2].x = corners[2].x + 1;
-	}
-	m23 = ((double)corners[2].y - corners[1].y) / ((double)corners[2].x - corners[1].x);
-	b23 = corners[2].y - (m23 * corners[2].x);
-	if (corners[3].x == corners[2].x) {
-		corners[3].x = corners[3].x + 1;
-	}
-	m34 = ((double)corners[3].y - corners[2].y) / ((double)corners[3].x - corners[2].x);
-	b34 = corners[3].y - (m34 * corners[3].x);
-	if (corners[4].x == corners[1].x) {
-		corners[4].x = corners[4].x + 1;
-	}
-	m41 = ((double)corners[0].y - corners[3].y) / ((double)corners[0].x - corners[3].x);
-	b41 = corners[0].y - (m41 * corners[0].x);
+// Range of pixels [ymin, ymax] covered by a polygon in the row at x
+struct R2ImageSpan {
+  int x, ymin, ymax;
+};
+
+
+// Rasterizes the convex quadrilateral with the given corners (in any order)
+//    into one span per covered row, clipped to a width x height image;
+//    a pixel is covered if its center lies inside or on the quadrilateral
+static void RasterizeQuad(const R2Point quad[4], int width, int height, std::vector<R2ImageSpan>& spans) {
+  spans.clear();
+
+  // order the corners around their centroid, so consecutive corners share an edge
+  double cx = 0.25 * (quad[0].X() + quad[1].X() + quad[2].X() + quad[3].X());
+  double cy = 0.25 * (quad[0].Y() + quad[1].Y() + quad[2].Y() + quad[3].Y());
+  R2Point corners[4];
+  double angles[4];
+  for (int k = 0; k < 4; k++) {
+    double angle = atan2(quad[k].Y() - cy, quad[k].X() - cx);
+    int pos = k;
+    while (pos > 0 && angles[pos-1] > angle) {
+      angles[pos] = angles[pos-1];
+      corners[pos] = corners[pos-1];
+      pos--;
+    }
+    angles[pos] = angle;
+    corners[pos] = quad[k];
+  }
 
-	// "above" variables are true if we want points above corresponding line
-	bool above12 = false, above23 = false, above34 = false, above41 = false;
-	if (corners[2].y >= (m12 * corners[2].x) + b12) {
-		above12 = true;
-	}
-	if (corners[0].y >= (m23 * corners[0].x) + b23) {
-		above23 = true;
-	}
-	if (corners[0].y >= (m34 * corners[0].x) + b34) {
-		above34 = true;
-	}
-	if (corners[2].y >= (m41 * corners[2].x) + b41) {
-		above41 = true;
-	}
+  double minx = corners[0].X(), maxx = corners[0].X();
+  for (int k = 1; k < 4; k++) {
+    if (corners[k].X() < minx) minx = corners[k].X();
+    if (corners[k].X() > maxx) maxx = corners[k].X();
+  }
+  int xstart = (int) ceil(minx), xend = (int) floor(maxx);
+  if (xstart < 0) xstart = 0;
+  if (xend > width - 1) xend = width - 1;
 
-	for (int i = 0; i < width; i++) {
-    	for (int j = 0; j < height; j++) {
-    		if (((above12 && (j >= (m12 * i) + b12)) || (!above12 && (j <= (m12 * i) + b12))) &&
-		        ((above23 && (j >= (m23 * i) + b23)) || (!above23 && (j <= (m23 * i) + b23))) &&
-		        ((above34 && (j >= (m34 * i) + b34)) || (!above34 && (j <= (m34 * i) + b34))) &&
-		        ((above41 && (j >= (m41 * i) + b41)) || (!above41 && (j <= (m41 * i) + b41)))) {
-
-    			// these are the pixels to warp -- Hx = x'
-	 			Point estimation;
-		        float estx = (model[0][0] * i) + (model[0][1] * j) + model[0][2];
-		        float esty = (model[1][0] * i) + (model[1][1] * j) + model[1][2];
-		        float estz = (model[2][0] * i) + (model[2][1] * j) + model[2][2];
-		        estimation.x = (int) (estx / estz);
-		        estimation.y = (int) (esty / estz);
-
-		        //// testing homography model ////
-		        if (estimation.x < 0 || estimation.y < 0 || estimation.x > width || estimation.y > height) {
-		        	fprintf(stderr,"Oops, (%d , %d) not on the image\n",estimation.x,estimation.y);
-		        }
-
-		        Pixel(i,j) = freezeFrame->Pixel(estimation.x, estimation.y);
-		        // replace above to fill in frame with black:
-		        //Pixel(i,j).SetRed(0.0); Pixel(i,j).SetGreen(0.0); Pixel(i,j).SetBlue(0.0); 
-		        Pixel(i,j).Clamp();
-    		}
-    	}
+  // the covered part of each row lies between the lowest and highest edge crossing
+  for (int x = xstart; x <= xend; x++) {
+    double ylo = DBL_MAX, yhi = -DBL_MAX;
+    for (int k = 0; k < 4; k++) {
+      const R2Point& p = corners[k];
+      const R2Point& q = corners[(k+1) % 4];
+      double x0 = p.X() < q.X() ? p.X() : q.X();
+      double x1 = p.X() < q.X() ? q.X() : p.X();
+      if (x < x0 || x > x1) continue;
+      if (x0 == x1) {
+        // edge along the row: both end points bound the span
+        double y0 = p.Y() < q.Y() ? p.Y() : q.Y();
+        double y1 = p.Y() < q.Y() ? q.Y() : p.Y();
+        if (y0 < ylo) ylo = y0;
+        if (y1 > yhi) yhi = y1;
+      } else {
+        // (end points are taken exactly, so corners on a pixel center are kept)
+        double y;
+        if (x == p.X()) y = p.Y();
+        else if (x == q.X()) y = q.Y();
+        else y = p.Y() + (x - p.X()) * (q.Y() - p.Y()) / (q.X() - p.X());
+        if (y < ylo) ylo = y;
+        if (y > yhi) yhi = y;
+      }
     }
+    if (ylo > yhi) continue;
+
+    R2ImageSpan span;
+    span.x = x;
+    span.ymin = (int) ceil(ylo);
+    span.ymax = (int) floor(yhi);
+    if (span.ymin < 0) span.ymin = 0;
+    if (span.ymax > height - 1) span.ymax = height - 1;
+    if (span.ymin <= span.ymax) spans.push_back(span);
+  }
 }
 
 
-// Detects the locations of the 4 corners in "this" image, and fills
-//    in the given "corners" array with the point coordinates, so they
-//    can be accessed from the calling function
-void R2Image::detectFrameCorners(Point corners[4]) {
-  std::vector<Point> greenPts;
-
-  // find the MAX total green + blue components of any single pixel in the image
-  float max_GandB = 0.0;
-  for (int i = 0; i < width; i++) {
-    for (int j = 0; j < height; j++) {
-      float currGB = Pixel(i,j).Green() + Pixel(i,j).Blue();
-      if (currGB > max_GandB) {
-        max_GandB = currGB;
-      }
+// Pixels of a span are warped in blocks of WARP_BLOCK (so the compiler can keep
+//    a block in vector registers). The homogeneous coordinates are updated
+//    incrementally from block to block, and recomputed exactly once a bound on
+//    the rounding error the updates have added to the projected coordinates
+//    reaches WARP_MAX_DRIFT pixels
+#define WARP_BLOCK 8
+#define WARP_MAX_DRIFT 1e-6
+
+// Covered pixels per band when the warp is split across threads
+#define WARP_BAND_PIXELS 16384
+
+
+// Warps the pixels of one row span of "image" from "freezeFrame" through the
+//    homography H; along the span x is fixed, so the homogeneous coordinates
+//    (H[r][0]*x + H[r][1]*y + H[r][2]) advance by H[r][1] per pixel. The
+//    sampling method is a template argument so each method gets its own loop.
+//    The pyramid level is chosen per block from the Jacobian of the mapping
+template <int sampling_method>
+static void WarpSpan(R2Image *image, const R2ImagePyramid *freezePyramid, const R2ImageSpan& span, const R2Homography& H) {
+  const int x = span.x;
+  const double dX = H[0][1], dY = H[1][1], dZ = H[2][1];
+  R2Pixel *row = image->Pixels(x);
+
+  double u[WARP_BLOCK], v[WARP_BLOCK];
+  double X0 = 0, Y0 = 0, Z0 = 0, drift = WARP_MAX_DRIFT;
+  for (int y = span.ymin; y <= span.ymax; y += WARP_BLOCK) {
+    int n = span.ymax - y + 1;
+    if (n > WARP_BLOCK) n = WARP_BLOCK;
+
+    // exact homogeneous coordinates, at the start or once the drift is too large
+    if (!(drift < WARP_MAX_DRIFT)) {
+      X0 = (H[0][0] * x) + (H[0][1] * y) + H[0][2];
+      Y0 = (H[1][0] * x) + (H[1][1] * y) + H[1][2];
+      Z0 = (H[2][0] * x) + (H[2][1] * y) + H[2][2];
+      drift = 0;
     }
-  }
 
-  // find all points that fit into the given constraints (i.e. GREEN enough points)
-  Point currPt;
-  for (int i = 0; i < width; i++) {
-    for (int j = 0; j < height; j++) {
-      float currGB = Pixel(i,j).Green() + Pixel(i,j).Blue();
-      if (currGB / max_GandB > .3 && Pixel(i,j).Green() > Pixel(i,j).Blue() && Pixel(i,j).Red() < .2) {
-        currPt.x = i;
-        currPt.y = j;
-        greenPts.push_back(currPt);
-      }
+    // project a whole block, with one reciprocal per pixel
+    for (int k = 0; k < WARP_BLOCK; k++) {
+      double rz = 1.0 / (Z0 + k * dZ);
+      u[k] = (X0 + k * dX) * rz;
+      v[k] = (Y0 + k * dY) * rz;
     }
-  }
 
-  Point centroids[4];
-  // initialize centroids for K-means:
-  for (int i = 0; i < 4; i++) {
-    int randPtInd;
-    while (true) {
-      randPtInd = rand() % greenPts.size();
-      bool valid = true;
-      for (int j = 0; j < i; j++) {
-        if (abs(greenPts[randPtInd].x - centroids[j].x) < 100 && abs(greenPts[randPtInd].y - centroids[j].y) < 100) {
-          valid = false;
-        }
+    // footprint of one pixel in the freeze frame, from the partial derivatives
+    //    of (X/Z, Y/Z) along and across the row at the first pixel of the block
+    double rz = 1.0 / Z0;
+    double dudx = (H[0][0] - u[0] * H[2][0]) * rz, dvdx = (H[1][0] - v[0] * H[2][0]) * rz;
+    double dudy = (H[0][1] - u[0] * H[2][1]) * rz, dvdy = (H[1][1] - v[0] * H[2][1]) * rz;
+    double footprint = dudx*dudx + dvdx*dvdx;
+    if (dudy*dudy + dvdy*dvdy > footprint) footprint = dudy*dudy + dvdy*dvdy;
+    double lod = (footprint > 1.0) ? 0.5 * log2(footprint) : 0.0;
+
+    // each update rounds X, Y and Z by at most DBL_EPSILON of their size, which
+    //    moves (X/Z, Y/Z) by at most DBL_EPSILON * (|X| + |Y| + (|u| + |v|) * |Z|) / |Z|
+    X0 += WARP_BLOCK * dX;
+    Y0 += WARP_BLOCK * dY;
+    Z0 += WARP_BLOCK * dZ;
+    drift += DBL_EPSILON * (fabs(X0) + fabs(Y0) + (fabs(u[0]) + fabs(v[0])) * fabs(Z0)) / fabs(Z0);
+
+    if (lod == 0.0) {
+      const R2Image& freezeFrame = freezePyramid->Level(0);
+      for (int k = 0; k < n; k++) {
+        row[y + k] = SampleImage<sampling_method>(freezeFrame, u[k], v[k]);
+        row[y + k].Clamp();
       }
-      if (valid == true) {
-        centroids[i] = greenPts[randPtInd];
-        break;
+    } else {
+      for (int k = 0; k < n; k++) {
+        row[y + k] = SamplePyramid<sampling_method>(*freezePyramid, u[k], v[k], lod);
+        row[y + k].Clamp();
       }
     }
   }
+}
 
-  // modified k-means 5 iterations -- 
-  // might actually be able to find correct centroids with only 1 iteration if no outlying green points
-  int ptInds[greenPts.size()];
-  for (int i = 0; i < 5; i++) {
-    for (int j = 0; j < greenPts.size(); j++) {
-      int closestCentroid = 0;
-      for (int k = 1; k < 4; k++) {
-        if (sqrt(pow(greenPts[j].x - centroids[k].x,2) + pow(greenPts[j].y - centroids[k].y,2)) < 
-              sqrt(pow(greenPts[j].x - centroids[closestCentroid].x,2) + pow(greenPts[j].y - centroids[closestCentroid].y,2))) {
-          closestCentroid = k;
-        }
-      }
-      ptInds[j] = closestCentroid;
-    }
 
-    for (int k = 0; k < 4; k++) {
-      float numPts = 0;
-      int totX = 0;
-      int totY = 0;
-      for (int j = 0; j < greenPts.size(); j++) {
-        if (ptInds[j] == k) {
-          totX += greenPts[j].x;
-          totY += greenPts[j].y;
-          numPts++;
-        }
+void R2Image::inverseWarp(const R2ImagePyramid * freezePyramid, R2Point curCorners[4], const R2Homography& model, int sampling_method) {
+  // only visit the pixels covered by the frame, one row span at a time
+  std::vector<R2ImageSpan> spans;
+  RasterizeQuad(curCorners, width, height, spans);
+
+  // split the spans into bands of about WARP_BAND_PIXELS covered pixels each, so
+  //    small frames stay on one thread and large ones use the whole pool
+  long long area = 0;
+  for (unsigned int s = 0; s < spans.size(); s++) {
+    area += spans[s].ymax - spans[s].ymin + 1;
+  }
+  int nbands = (int) (area / WARP_BAND_PIXELS);
+  if (nbands > 4 * R2NumThreads()) nbands = 4 * R2NumThreads();
+
+  // these are the pixels to warp -- Hx = x'
+  R2ParallelFor(0, (int) spans.size(), nbands, [&](int begin, int end) {
+    for (int s = begin; s < end; s++) {
+      switch (sampling_method) {
+      case R2_IMAGE_BILINEAR_SAMPLING: WarpSpan<R2_IMAGE_BILINEAR_SAMPLING>(this, freezePyramid, spans[s], model); break;
+      case R2_IMAGE_GAUSSIAN_SAMPLING: WarpSpan<R2_IMAGE_GAUSSIAN_SAMPLING>(this, freezePyramid, spans[s], model); break;
+      default: WarpSpan<R2_IMAGE_POINT_SAMPLING>(this, freezePyramid, spans[s], model); break;
       }
-      centroids[k].x = totX / numPts;
-      centroids[k].y = totY / numPts;
     }
-  }
+  });
+}
 
-  corners[0] = centroids[0];
-  corners[1] = centroids[1];
-  corners[2] = centroids[2];
-  corners[3] = centroids[3];
+
+// Returns the squared distance between two points
+static double SquaredDistance(const R2Point& p1, const R2Point& p2) {
+  double dx = p1.X() - p2.X();
+  double dy = p1.Y() - p2.Y();
+  return dx*dx + dy*dy;
 }
 
 
-// Detects the locations of the 4 corners in "this" image, and fills
-//    in the given "corners" array with the point coordinates, so they
-//    can be accessed from the calling function
-void R2Image::detectLocalCorners(Point corners[4]) {
-  std::vector<Point> greenPts;
-
-  // find the MAX total green + blue components of any single pixel in the image
-  float max_GandB = 0.0;
-  for (int i = 0; i < width; i++) {
-    for (int j = 0; j < height; j++) {
-      float currGB = Pixel(i,j).Green() + Pixel(i,j).Blue();
+// Returns how strongly a pixel looks like a frame marker (0 if it is not one);
+//    max_GandB is the largest green + blue sum found in the image
+static double MarkerWeight(const R2Pixel& pixel, double max_GandB) {
+  double currGB = pixel.Green() + pixel.Blue();
+  if (currGB / max_GandB > .3 && pixel.Green() > pixel.Blue() && pixel.Red() < .2) {
+    return currGB / max_GandB;
+  }
+  return 0.0;
+}
+
+
+// Finds the 4 marker blobs with k-means over the marker pixels on a grid
+//    sampled every 'step' pixels, and fills in "centroids" with their
+//    (coarse) centers in full resolution coordinates; returns 0 (leaving
+//    "centroids" unchanged) if there are no marker pixels
+int R2Image::findMarkerCentroids(R2Point centroids[4], int step) {
+  std::vector<R2Point> greenPts;
+
+  // find the MAX total green + blue components of any single sampled pixel in the image
+  double max_GandB = 0.0;
+  for (int i = 0; i < width; i += step) {
+    for (int j = 0; j < height; j += step) {
+      double currGB = Pixel(i,j).Green() + Pixel(i,j).Blue();
       if (currGB > max_GandB) {
         max_GandB = currGB;
       }
     }
   }
 
-  // find all points that fit into the given constraints (i.e. GREEN enough points)
-  Point currPt;
-  for (int i = 0; i < width; i++) {
-    for (int j = 0; j < height; j++) {
-      float currGB = Pixel(i,j).Green() + Pixel(i,j).Blue();
-      if (currGB / max_GandB > .3 && Pixel(i,j).Green() > Pixel(i,j).Blue() && Pixel(i,j).Red() < .2) {
-        currPt.x = i;
-        currPt.y = j;
-        greenPts.push_back(currPt);
+  // find all sampled points that fit into the given constraints (i.e. GREEN enough points)
+  for (int i = 0; i < width; i += step) {
+    for (int j = 0; j < height; j += step) {
+      if (MarkerWeight(Pixel(i,j), max_GandB) > 0.0) {
+        greenPts.push_back(R2Point(i, j));
       }
     }
   }
+  if (greenPts.empty()) {
+    fprintf(stderr, "No frame markers found in image\n");
+    return 0;
+  }
 
-  Point centroids[4];
   // initialize centroids for K-means:
   for (int i = 0; i < 4; i++) {
     int randPtInd;
@@ -486,7 +597,7 @@ void R2Image::detectLocalCorners(Point corners[4]) {
       randPtInd = rand() % greenPts.size();
       bool valid = true;
       for (int j = 0; j < i; j++) {
-        if (abs(greenPts[randPtInd].x - centroids[j].x) < 100 && abs(greenPts[randPtInd].y - centroids[j].y) < 100) {
+        if (fabs(greenPts[randPtInd].X() - centroids[j].X()) < 100 && fabs(greenPts[randPtInd].Y() - centroids[j].Y()) < 100) {
           valid = false;
         }
       }
@@ -499,13 +610,15 @@ void R2Image::detectLocalCorners(Point corners[4]) {
 
   // modified k-means 5 iterations -- 
   // might actually be able to find correct centroids with only 1 iteration if no outlying green points
-  int ptInds[greenPts.size()];
+  std::vector<int> ptInds(greenPts.size());
   for (int i = 0; i < 5; i++) {
-    for (int j = 0; j < greenPts.size(); j++) {
+    for (unsigned int j = 0; j < greenPts.size(); j++) {
       int closestCentroid = 0;
+      double closestDist = SquaredDistance(greenPts[j], centroids[0]);
       for (int k = 1; k < 4; k++) {
-        if (sqrt(pow(greenPts[j].x - centroids[k].x,2) + pow(greenPts[j].y - centroids[k].y,2)) < 
-              sqrt(pow(greenPts[j].x - centroids[closestCentroid].x,2) + pow(greenPts[j].y - centroids[closestCentroid].y,2))) {
+        double dist = SquaredDistance(greenPts[j], centroids[k]);
+        if (dist < closestDist) {
+          closestDist = dist;
           closestCentroid = k;
         }
       }
@@ -513,19 +626,94 @@ void R2Image::detectLocalCorners(Point corners[4]) {
     }
 
     for (int k = 0; k < 4; k++) {
-      float numPts = 0;
-      int totX = 0;
-      int totY = 0;
-      for (int j = 0; j < greenPts.size(); j++) {
+      double numPts = 0;
+      double totX = 0;
+      double totY = 0;
+      for (unsigned int j = 0; j < greenPts.size(); j++) {
         if (ptInds[j] == k) {
-          totX += greenPts[j].x;
-          totY += greenPts[j].y;
+          totX += greenPts[j].X();
+          totY += greenPts[j].Y();
           numPts++;
         }
       }
-      centroids[k].x = totX / numPts;
-      centroids[k].y = totY / numPts;
+      if (numPts > 0) {
+        centroids[k].Reset(totX / numPts, totY / numPts);
+      }
+    }
+  }
+
+  // Return success
+  return 1;
+}
+
+
+// Moves "corner" to the sub-pixel center of the marker blob around it, using
+//    the marker-weighted centroid of the full resolution pixels in a window
+//    of the given radius (re-centered until it stops moving)
+void R2Image::refineCorner(R2Point& corner, int radius) {
+  // marker weights are relative to the brightest green + blue in the window
+  for (int iter = 0; iter < R2_IMAGE_CORNER_REFINE_ITERATIONS; iter++) {
+    int xmin = (int) floor(corner.X()) - radius, xmax = (int) ceil(corner.X()) + radius;
+    int ymin = (int) floor(corner.Y()) - radius, ymax = (int) ceil(corner.Y()) + radius;
+    if (xmin < 0) xmin = 0;
+    if (ymin < 0) ymin = 0;
+    if (xmax > width - 1) xmax = width - 1;
+    if (ymax > height - 1) ymax = height - 1;
+
+    double max_GandB = 0.0;
+    for (int i = xmin; i <= xmax; i++) {
+      for (int j = ymin; j <= ymax; j++) {
+        double currGB = Pixel(i,j).Green() + Pixel(i,j).Blue();
+        if (currGB > max_GandB) max_GandB = currGB;
+      }
     }
+    if (max_GandB <= 0.0) return;
+
+    double totW = 0.0, totX = 0.0, totY = 0.0;
+    for (int i = xmin; i <= xmax; i++) {
+      for (int j = ymin; j <= ymax; j++) {
+        double w = MarkerWeight(Pixel(i,j), max_GandB);
+        totW += w;
+        totX += w * i;
+        totY += w * j;
+      }
+    }
+    if (totW <= 0.0) return;
+
+    R2Point refined(totX / totW, totY / totW);
+    double shift = SquaredDistance(refined, corner);
+    corner = refined;
+    if (shift < 0.01 * 0.01) break;
+  }
+}
+
+
+// Detects the locations of the 4 corners in "this" image, and fills
+//    in the given "corners" array with the point coordinates, so they
+//    can be accessed from the calling function (they are left unchanged
+//    if no markers are found)
+void R2Image::detectFrameCorners(R2Point corners[4]) {
+  // find the markers on a quarter resolution grid, then refine them at full resolution
+  R2Point centroids[4];
+  if (!findMarkerCentroids(centroids, R2_IMAGE_CORNER_DETECTION_STEP)) return;
+
+  for (int i = 0; i < 4; i++) {
+    refineCorner(centroids[i], R2_IMAGE_CORNER_REFINE_RADIUS);
+    corners[i] = centroids[i];
+  }
+}
+
+
+// Detects the locations of the 4 corners in "this" image, and fills
+//    in the given "corners" array with the point coordinates, so they
+//    can be accessed from the calling function
+void R2Image::detectLocalCorners(R2Point corners[4]) {
+  // find the markers on a quarter resolution grid, then refine them at full resolution
+  // (the corners are left unchanged if no markers are found)
+  R2Point centroids[4];
+  if (!findMarkerCentroids(centroids, R2_IMAGE_CORNER_DETECTION_STEP)) return;
+  for (int i = 0; i < 4; i++) {
+    refineCorner(centroids[i], R2_IMAGE_CORNER_REFINE_RADIUS);
   }
 
   // map closest centroids to corners to each other
@@ -533,7 +721,7 @@ void R2Image::detectLocalCorners(Point corners[4]) {
     double lowest_dist = FLT_MAX;
     int lowest_centroid_index = 0;
     for (int j = 0; j < 4; j++) { // loop through centroids
-      double dist = sqrt(pow(centroids[j].x-corners[i].x,2) + pow(centroids[j].y-corners[i].y,2));
+      double dist = R2Distance(centroids[j], corners[i]);
       // update if necessary
       if (dist < lowest_dist) {
         lowest_dist = dist;
@@ -545,53 +733,13 @@ void R2Image::detectLocalCorners(Point corners[4]) {
 }
 
 
-// Computes and returns the model homography matrix given 4 point correspondences
-// If 'fromPoints' and 'toPoints' are from image A and B respectively, the returned
+// Computes the model homography matrix given 4 point correspondences
+// If 'fromPoints' and 'toPoints' are from image A and B respectively, the computed
 //    homography matrix 'H' should calculate x' = Hx where x is a point of A and x' is
-//    the corresponding point of B (both points in homogeneous coordinates)
-double** R2Image::DLT(Point fromPoints[4], Point toPoints[4]) {
-  double** Ai = dmatrix(1,8,1,9);
-  int r1,r2;
-  int pt1[3], pt2[3];
-  for (int i = 0; i < 4; i++) {
-    pt1[0] = fromPoints[i].x;
-    pt1[1] = fromPoints[i].y;
-    pt1[2] = 1;
-    pt2[0] = toPoints[i].x;
-    pt2[1] = toPoints[i].y;
-    pt2[2] = 1;
-    r1 = (2*i)+1;
-    r2 = (2*i)+2;
-    for (int j = 1; j<=3; j++) {
-      Ai[r1][j] = 0;
-      Ai[r1][j+3] = (-1)*pt2[2]*pt1[j-1];
-      Ai[r1][j+6] = pt2[1]*pt1[j-1];
-      Ai[r2][j] = pt2[2]*pt1[j-1];
-      Ai[r2][j+3] = 0;
-      Ai[r2][j+6] = (-1)*pt2[0]*pt1[j-1];
-    }
-  }
-
-  // now that the Ai matrix is populated, run svd on it:
-  double singularValues[7]; // 1..6
-  double** nullspaceMatrix = dmatrix(1,9,1,9);
-  svdcmp(Ai, 8, 9, singularValues, nullspaceMatrix);
-  // now find smallest SV and take corresponding eigenvector as H to return
-  int smallestIndex = 1;
-  for(int i = 2; i < 10; i++) {
-    if(singularValues[i] < singularValues[smallestIndex]) {
-      smallestIndex=i;
-    }
-  }
-
-  double** H = new double*[3];
-  H[0] = new double[3];
-  H[1] = new double[3];
-  H[2] = new double[3];
-  for (int i = 0; i < 9; i++) {
-    H[i/3][i%3] = nullspaceMatrix[i+1][smallestIndex];
-  }
-  return H;
+//    the corresponding point of B (both points in homogeneous coordinates).
+//    Returns 0 if the points are degenerate (three of them collinear)
+int R2Image::DLT(const R2Point fromPoints[4], const R2Point toPoints[4], R2Homography& H) {
+  return R2ComputeHomography(fromPoints, toPoints, H);
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -606,39 +754,66 @@ Brighten(double factor)
 {
   // Brighten the image by multiplying each pixel component by the factor.
   // This is implemented for you as an example of how to access and set pixels
-  for (int i = 0; i < width; i++) {
-    for (int j = 0;  j < height; j++) {
-      Pixel(i,j) *= factor;
-      Pixel(i,j).Clamp();
-    }
+  R2PixelOperations operations;
+  operations.Scale(factor);
+  operations.Clamp();
+  operations.Apply(*this);
+}
+
+// Replaces the color channels of an image by their Sobel derivative along
+//    x (or y if along_y is set), as raw filter responses that may be negative;
+//    alpha is kept
+static void
+Sobel(R2Image *image, int along_y, const R2PixelOperations *operations)
+{
+  static const float derivative[3] = { -1, 0, 1 };
+  static const float smoothing[3] = { 1, 2, 1 };
+  int width = image->Width(), height = image->Height();
+  std::vector<float> planes[R2_IMAGE_NUM_CHANNELS];
+  R2ImageToPlanes(*image, planes, operations);
+  for (int k = 0; k < R2_IMAGE_ALPHA_CHANNEL; k++) {
+    R2ConvolveSeparable(planes[k].data(), width, height, (along_y) ? smoothing : derivative, 3,
+      (along_y) ? derivative : smoothing, 3, planes[k].data());
   }
+  R2PlanesToImage(planes, *image);
 }
 
 void R2Image::
-SobelX(void)
+SobelX(const R2PixelOperations *operations)
 {
 	// Apply the Sobel oprator to the image in X direction
-  
-  // FILL IN IMPLEMENTATION HERE (REMOVE PRINT STATEMENT WHEN DONE)
-  fprintf(stderr, "SobelX() not implemented\n");
+  Sobel(this, 0, operations);
 }
 
 void R2Image::
-SobelY(void)
+SobelY(const R2PixelOperations *operations)
 {
 	// Apply the Sobel oprator to the image in Y direction
-  
-  // FILL IN IMPLEMENTATION HERE (REMOVE PRINT STATEMENT WHEN DONE)
-  fprintf(stderr, "SobelY() not implemented\n");
+  Sobel(this, 1, operations);
 }
 
 void R2Image::
-LoG(void)
+LoG(double sigma, int log_method, const R2PixelOperations *operations)
 {
   // Apply the LoG oprator to the image
-  
-  // FILL IN IMPLEMENTATION HERE (REMOVE PRINT STATEMENT WHEN DONE)
-  fprintf(stderr, "LoG() not implemented\n");
+  // Each color channel is replaced by its scale-normalized response around
+  // 50% grey, either exactly or from the difference of two Gaussians
+  std::vector<float> planes[R2_IMAGE_NUM_CHANNELS];
+  std::vector<float> response((size_t) width * height);
+  R2ImageToPlanes(*this, planes, operations);
+  for (int k = 0; k < R2_IMAGE_ALPHA_CHANNEL; k++) {
+    if (log_method == R2_IMAGE_DOG_LOG) {
+      R2ScaleSpace space(planes[k].data(), width, height, sigma, 2);
+      space.DifferenceOfGaussians(0, response.data());
+    }
+    else {
+      R2LaplacianOfGaussian(planes[k].data(), width, height, sigma, response.data());
+      for (size_t i = 0; i < response.size(); i++) response[i] *= (float) (sigma * sigma);
+    }
+    for (size_t i = 0; i < response.size(); i++) response[i] += 0.5f;
+    planes[k].swap(response);
+  }
+  R2PlanesToImage(planes, *this);
 }
 
 
@@ -648,41 +823,133 @@ ChangeSaturation(double factor)
 {
   // Changes the saturation of an image
   // Find a formula that changes the saturation without affecting the image brightness
-
-  // FILL IN IMPLEMENTATION HERE (REMOVE PRINT STATEMENT WHEN DONE)
-  fprintf(stderr, "ChangeSaturation(%g) not implemented\n", factor);
+  // Each color is moved away from its luminance (a grey of the same brightness)
+  R2PixelOperations operations;
+  operations.Saturate(factor);
+  operations.Clamp();
+  operations.Apply(*this);
 }
 
 
 // Linear filtering ////////////////////////////////////////////////
 void R2Image::
-Blur(double sigma)
+Blur(double sigma, int blur_method, const R2PixelOperations *operations)
 {
   // Gaussian blur of the image. Separable solution is preferred
-  
-  // FILL IN IMPLEMENTATION HERE (REMOVE PRINT STATEMENT WHEN DONE)
-  fprintf(stderr, "Blur(%g) not implemented\n", sigma);
+  // Every channel (alpha included) is blurred separately on float planes
+  std::vector<float> planes[R2_IMAGE_NUM_CHANNELS];
+  std::vector<float> blurred((size_t) width * height);
+  R2ImageToPlanes(*this, planes, operations);
+  for (int k = 0; k < R2_IMAGE_NUM_CHANNELS; k++) {
+    R2GaussianBlur(planes[k].data(), width, height, sigma, blurred.data(), blur_method);
+    planes[k].swap(blurred);
+  }
+  R2PlanesToImage(planes, *this);
 }
 
 
+// Fraction of the Harris responses shown saturated (white or black)
+#define HARRIS_DISPLAY_FRACTION 0.001
+
 void R2Image::
 Harris(double sigma)
 {
     // Harris corner detector. Make use of the previously developed filters, such as the Gaussian blur filter
 	// Output should be 50% grey at flat regions, white at corners and black/dark near edges
-  
-  // FILL IN IMPLEMENTATION HERE (REMOVE PRINT STATEMENT WHEN DONE)
-  fprintf(stderr, "Harris(%g) not implemented\n", sigma);
+  std::vector<float> luminance, response((size_t) width * height);
+  R2ComputeLuminance(*this, luminance);
+  R2ComputeHarrisResponse(luminance.data(), width, height, sigma, response.data());
+
+  // Nothing to show for an empty image
+  if (response.empty()) return;
+
+  // Scale the response so the strongest HARRIS_DISPLAY_FRACTION of it saturates
+  std::vector<float> magnitudes(response.size());
+  for (size_t i = 0; i < response.size(); i++) magnitudes[i] = fabs(response[i]);
+  size_t n = (size_t) ((1 - HARRIS_DISPLAY_FRACTION) * (magnitudes.size() - 1));
+  std::nth_element(magnitudes.begin(), magnitudes.begin() + n, magnitudes.end());
+  double gain = (magnitudes[n] > 0) ? 0.5 / magnitudes[n] : 0;
+
+  // Show it around 50% grey, keeping alpha
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      const float *src = &response[(size_t) i * height];
+      R2Pixel *dst = Pixels(i);
+      for (int j = 0; j < height; j++) {
+        double value = 0.5 + gain * src[j];
+        dst[j] = R2Pixel(value, value, value, dst[j].Alpha());
+        dst[j].Clamp();
+      }
+    }
+  });
 }
 
 
 void R2Image::
-Sharpen()
+Sharpen(double amount, double radius, double threshold, const R2PixelOperations *operations)
 {
   // Sharpen an image using a linear filter. Use a kernel of your choosing.
+  // Unsharp mask: each color channel in turn is blurred on a float plane, then
+  // the pixels that differ from the blur by more than threshold are moved
+  // away from it by amount times the difference, in one pass over the image.
+  // Only float planes are allocated (the blur, filtering in place, may copy
+  // its plane), at most a quarter of the size of the image; alpha is kept
+  std::vector<float> blurred((size_t) width * height);
+  if (operations && operations->IsEmpty()) operations = NULL;
+  for (int k = 0; k < R2_IMAGE_ALPHA_CHANNEL; k++) {
+    if ((k == 0) && operations) {
+      // Apply the operations to the image as the first channel is read
+      R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+          R2Pixel *column = Pixels(i);
+          float *dst = &blurred[(size_t) i * height];
+          for (int j = 0; j < height; j++) {
+            operations->Apply(column[j]);
+            dst[j] = (float) column[j][0];
+          }
+        }
+      });
+    }
+    else {
+      R2ImageToPlane(*this, k, blurred.data());
+    }
+    R2GaussianBlur(blurred.data(), width, height, radius, blurred.data());
+    R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        R2Pixel *column = Pixels(i);
+        const float *blur = &blurred[(size_t) i * height];
+        for (int j = 0; j < height; j++) {
+          double value = column[j][k], detail = value - blur[j];
+          if (fabs(detail) <= threshold) continue;
+          value += amount * detail;
+          column[j][k] = (value < 0) ? 0 : ((value > 1) ? 1 : value);
+        }
+      }
+    });
+  }
+}
+
 
-  // FILL IN IMPLEMENTATION HERE (REMOVE PRINT STATEMENT WHEN DONE)
-  fprintf(stderr, "Sharpen() not implemented\n");
+// Image registration ////////////////////////////////////////////////
+
+// Blends otherImage over image with a 50% opacity, where pixel (x, y) of image
+//    corresponds to the point H (x, y) of otherImage (pixels that map outside of
+//    otherImage are left unchanged)
+static void BlendMapped(R2Image *image, const R2Image& otherImage, const R2Homography& H) {
+  const double umax = otherImage.Width() - 0.5, vmax = otherImage.Height() - 0.5;
+  R2ParallelFor(0, image->Width(), R2NumThreads(), [&](int begin, int end) {
+    for (int x = begin; x < end; x++) {
+      R2Pixel *row = image->Pixels(x);
+      for (int y = 0; y < image->Height(); y++) {
+        R2Point p = H.Transform(R2Point(x, y));
+        if (p.X() < -0.5 || p.X() >= umax || p.Y() < -0.5 || p.Y() >= vmax) continue;
+        R2Pixel other = otherImage.Sample(p.X(), p.Y(), R2_IMAGE_BILINEAR_SAMPLING);
+        double c[4];
+        for (int k = 0; k < 4; k++) c[k] = 0.5 * (row[y][k] + other[k]);
+        row[y] = R2Pixel(c);
+      }
+    }
+  });
 }
 
 
@@ -692,8 +959,17 @@ blendOtherImageTranslated(R2Image * otherImage)
 	// find at least 100 features on this image, and another 100 on the "otherImage". Based on these,
 	// compute the matching translation (pixel precision is OK), and blend the translated "otherImage" 
 	// into this image with a 50% opacity.
-	fprintf(stderr, "fit other image using translation and blend imageB over imageA\n");
-	return;
+  // The translation is found coarse to fine, without features
+  double dx, dy;
+  if (!R2RegisterTranslation(*this, *otherImage, dx, dy)) {
+    fprintf(stderr, "Unable to find a translation between the images\n");
+    return;
+  }
+
+  R2Homography H;
+  H[0][2] = dx;
+  H[1][2] = dy;
+  BlendMapped(this, *otherImage, H);
 }
 
 void R2Image::
@@ -701,8 +977,13 @@ blendOtherImageHomography(R2Image * otherImage)
 {
 	// find at least 100 features on this image, and another 100 on the "otherImage". Based on these,
 	// compute the matching homography, and blend the transformed "otherImage" into this image with a 50% opacity.
-	fprintf(stderr, "fit other image using a homography and blend imageB over imageA\n");
-	return;
+  R2Homography H;
+  if (!R2RegisterHomography(*this, *otherImage, H)) {
+    fprintf(stderr, "Unable to find a homography between the images\n");
+    return;
+  }
+
+  BlendMapped(this, *otherImage, H);
 }
 
 
@@ -21,6 +21,20 @@ typedef enum {
   R2_IMAGE_NUM_SAMPLING_METHODS
 } R2ImageSamplingMethod;
 
+typedef enum {
+  R2_IMAGE_AUTOMATIC_BLUR,
+  R2_IMAGE_DIRECT_BLUR,
+  R2_IMAGE_RECURSIVE_BLUR,
+  R2_IMAGE_BOX_BLUR,
+  R2_IMAGE_NUM_BLUR_METHODS
+} R2ImageBlurMethod;
+
+typedef enum {
+  R2_IMAGE_EXACT_LOG,
+  R2_IMAGE_DOG_LOG,
+  R2_IMAGE_NUM_LOG_METHODS
+} R2ImageLoGMethod;
+
 typedef enum {
   R2_IMAGE_OVER_COMPOSITION,
   R2_IMAGE_IN_COMPOSITION,
@@ -30,9 +44,31 @@ typedef enum {
 } R2ImageCompositeOperation;
 
 
-struct Point {
-  int x,y;
-};
+// Frame markers are searched on a grid sampled every STEP pixels (2 = quarter
+// resolution), then refined to sub-pixel accuracy at full resolution
+
+#define R2_IMAGE_CORNER_DETECTION_STEP 2
+#define R2_IMAGE_CORNER_REFINE_RADIUS 8
+#define R2_IMAGE_CORNER_REFINE_ITERATIONS 5
+
+// Default scale of the Laplacian of Gaussian filter
+
+#define R2_IMAGE_LOG_SIGMA 1.4
+
+// Default unsharp mask of Sharpen: strength, standard deviation of the blur,
+// and smallest difference from the blur that is sharpened
+
+#define R2_IMAGE_SHARPEN_AMOUNT 1.0
+#define R2_IMAGE_SHARPEN_RADIUS 1.0
+#define R2_IMAGE_SHARPEN_THRESHOLD 0.0
+
+// Class declarations
+
+class R2ImagePyramid;
+class R2Homography;
+class R2PixelOperations;
+
+
 
 // Class definition
 
@@ -58,6 +94,7 @@ class R2Image {
   R2Pixel *operator[](int row);
   const R2Pixel *operator[](int row) const;
   void SetPixel(int x, int y,  const R2Pixel& pixel);
+  R2Pixel Sample(double u, double v,  int sampling_method) const;
 
   // Image processing
   R2Image& operator=(const R2Image& image);
@@ -69,18 +106,21 @@ class R2Image {
   // show how SVD works
   void svdTest();
 
-  // Linear filtering operations
-  void SobelX();
-  void SobelY();
-  void LoG();
-  void Blur(double sigma);
+  // Linear filtering operations (the given per-pixel operations are applied
+  // first, as the pixels are read for filtering)
+  void SobelX(const R2PixelOperations *operations = NULL);
+  void SobelY(const R2PixelOperations *operations = NULL);
+  void LoG(double sigma = R2_IMAGE_LOG_SIGMA, int log_method = R2_IMAGE_EXACT_LOG,
+    const R2PixelOperations *operations = NULL);
+  void Blur(double sigma, int blur_method = R2_IMAGE_AUTOMATIC_BLUR, const R2PixelOperations *operations = NULL);
   void Harris(double sigma);
-  void Sharpen(void);
+  void Sharpen(double amount = R2_IMAGE_SHARPEN_AMOUNT, double radius = R2_IMAGE_SHARPEN_RADIUS,
+    double threshold = R2_IMAGE_SHARPEN_THRESHOLD, const R2PixelOperations *operations = NULL);
 
   // Magic Frame operations
-  void detectFrameCorners(Point frozenCorners[4]);
-  void detectLocalCorners(Point frozenCorners[4]);
-  void mapFramePixels(R2Image * freezeFrame, Point origCorners[4], Point curCorners[4]);
+  void detectFrameCorners(R2Point frozenCorners[4]);
+  void detectLocalCorners(R2Point frozenCorners[4]);
+  void mapFramePixels(const R2ImagePyramid * freezePyramid, R2Point origCorners[4], R2Point curCorners[4], int sampling_method = R2_IMAGE_POINT_SAMPLING);
 
   // further operations
   void blendOtherImageTranslated(R2Image * otherImage);
@@ -99,9 +139,10 @@ class R2Image {
  private:
   // Utility functions
   void Resize(int width, int height);
-  R2Pixel Sample(double u, double v,  int sampling_method);
-  double** DLT(Point fromPoints[4], Point toPoints[4]);
-  void inverseWarp(R2Image * freezeFrame, Point corners[4], double ** homographyModel);
+  int findMarkerCentroids(R2Point centroids[4], int step);
+  void refineCorner(R2Point& corner, int radius);
+  int DLT(const R2Point fromPoints[4], const R2Point toPoints[4], R2Homography& H);
+  void inverseWarp(const R2ImagePyramid * freezePyramid, R2Point corners[4], const R2Homography& homographyModel, int sampling_method);
 
  private:
   R2Pixel *pixels;
@@ -0,0 +1,166 @@
+// Source file for image pyramid class
+
+
+
+// Include files 
+
+#include "R2/R2.h"
+#include "R2Pixel.h"
+#include "R2Image.h"
+#include "R2ImagePyramid.h"
+#include "R2Parallel.h"
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constructors/Destructors
+////////////////////////////////////////////////////////////////////////
+
+// Each pixel of a reduced level is a weighted sum of 4x4 (or 2x2) pixels of
+//    the level below, centered on its position there (between pixels 2i and
+//    2i+1, so pixel centers stay consistent with ToLevel/FromLevel):
+//    the box filter averages pixels 2i and 2i+1, and the Gaussian filter is the
+//    binomial kernel (1 3 3 1)/8 over pixels 2i-1 to 2i+2 (the border is repeated)
+#define REDUCE_TAPS 4
+
+struct R2ReduceTaps {
+  int index[REDUCE_TAPS];
+  double weight[REDUCE_TAPS];
+};
+
+
+// Fills in the taps of every reduced pixel along an axis of n pixels
+static void 
+ComputeTaps(int n, int reduced_n, int filter, std::vector<R2ReduceTaps>& taps)
+{
+  static const double box[REDUCE_TAPS] = { 0.0, 0.5, 0.5, 0.0 };
+  static const double gaussian[REDUCE_TAPS] = { 1.0 / 8, 3.0 / 8, 3.0 / 8, 1.0 / 8 };
+  const double *weights = (filter == R2_IMAGE_PYRAMID_BOX_FILTER) ? box : gaussian;
+  taps.resize(reduced_n);
+  for (int i = 0; i < reduced_n; i++) {
+    for (int a = 0; a < REDUCE_TAPS; a++) {
+      int index = 2*i - 1 + a;
+      taps[i].index[a] = (index < 0) ? 0 : (index >= n) ? n - 1 : index;
+      taps[i].weight[a] = weights[a];
+    }
+  }
+}
+
+
+// Builds the next level in a single pass over the given one: each reduced
+//    row is filtered across rows into a buffer, which is then filtered and
+//    subsampled along the row (so no intermediate image is needed)
+static R2Image *
+Reduce(const R2Image& image, int filter)
+{
+  int width = image.Width() / 2, height = image.Height() / 2;
+  if (width < 1) width = 1;
+  if (height < 1) height = 1;
+  R2Image *reduced = new R2Image(width, height);
+  assert(reduced);
+
+  std::vector<R2ReduceTaps> xtaps, ytaps;
+  ComputeTaps(image.Width(), width, filter, xtaps);
+  ComputeTaps(image.Height(), height, filter, ytaps);
+
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    std::vector<double> buffer(4 * image.Height());
+    for (int i = begin; i < end; i++) {
+      const R2ReduceTaps& xt = xtaps[i];
+      const R2Pixel *rows[REDUCE_TAPS];
+      for (int a = 0; a < REDUCE_TAPS; a++) rows[a] = image[xt.index[a]];
+      for (int j = 0; j < image.Height(); j++) {
+        for (int k = 0; k < 4; k++) {
+          double sum = 0;
+          for (int a = 0; a < REDUCE_TAPS; a++) sum += xt.weight[a] * rows[a][j][k];
+          buffer[4*j + k] = sum;
+        }
+      }
+      R2Pixel *dst = (*reduced)[i];
+      for (int j = 0; j < height; j++) {
+        const R2ReduceTaps& yt = ytaps[j];
+        double c[4] = { 0, 0, 0, 0 };
+        for (int b = 0; b < REDUCE_TAPS; b++) {
+          for (int k = 0; k < 4; k++) c[k] += yt.weight[b] * buffer[4*yt.index[b] + k];
+        }
+        dst[j] = R2Pixel(c);
+      }
+    }
+  });
+
+  return reduced;
+}
+
+
+
+void 
+R2ReducePlane(const float *plane, int width, int height, std::vector<float>& reduced, 
+  int& reduced_width, int& reduced_height, int filter)
+{
+  // Same as Reduce, on a single channel
+  reduced_width = (width / 2 < 1) ? 1 : width / 2;
+  reduced_height = (height / 2 < 1) ? 1 : height / 2;
+  reduced.resize((size_t) reduced_width * reduced_height);
+
+  std::vector<R2ReduceTaps> xtaps, ytaps;
+  ComputeTaps(width, reduced_width, filter, xtaps);
+  ComputeTaps(height, reduced_height, filter, ytaps);
+
+  R2ParallelFor(0, reduced_width, R2NumThreads(), [&](int begin, int end) {
+    std::vector<float> buffer(height);
+    for (int i = begin; i < end; i++) {
+      const R2ReduceTaps& xt = xtaps[i];
+      const float *rows[REDUCE_TAPS];
+      float wx[REDUCE_TAPS];
+      for (int a = 0; a < REDUCE_TAPS; a++) {
+        rows[a] = plane + (size_t) xt.index[a] * height;
+        wx[a] = (float) xt.weight[a];
+      }
+      for (int j = 0; j < height; j++) {
+        buffer[j] = wx[0] * rows[0][j] + wx[1] * rows[1][j] + wx[2] * rows[2][j] + wx[3] * rows[3][j];
+      }
+      float *dst = &reduced[(size_t) i * reduced_height];
+      for (int j = 0; j < reduced_height; j++) {
+        const R2ReduceTaps& yt = ytaps[j];
+        float sum = 0;
+        for (int b = 0; b < REDUCE_TAPS; b++) sum += (float) yt.weight[b] * buffer[yt.index[b]];
+        dst[j] = sum;
+      }
+    }
+  });
+}
+
+
+
+R2ImagePyramid::
+R2ImagePyramid(const R2Image& image, int max_levels, int filter)
+  : levels(NULL),
+    nlevels(1)
+{
+  // Count levels, halving until the image is a single pixel wide or high
+  // (max_levels <= 0 means no limit)
+  int width = image.Width(), height = image.Height();
+  while (width > 1 && height > 1 && (max_levels <= 0 || nlevels < max_levels)) {
+    width /= 2;
+    height /= 2;
+    nlevels++;
+  }
+
+  // Allocate and build levels
+  levels = new R2Image * [ nlevels ];
+  assert(levels);
+  levels[0] = new R2Image(image);
+  for (int i = 1; i < nlevels; i++) {
+    levels[i] = Reduce(*levels[i-1], filter);
+  }
+}
+
+
+
+R2ImagePyramid::
+~R2ImagePyramid(void)
+{
+  // Free levels
+  for (int i = 0; i < nlevels; i++) delete levels[i];
+  delete [] levels;
+}
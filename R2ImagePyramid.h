@@ -0,0 +1,110 @@
+// Include file for image pyramid class
+#ifndef R2_IMAGE_PYRAMID_INCLUDED
+#define R2_IMAGE_PYRAMID_INCLUDED
+
+
+
+// Include files
+
+#include <vector>
+
+
+
+// Constant definitions
+
+enum {
+  R2_IMAGE_PYRAMID_BOX_FILTER,
+  R2_IMAGE_PYRAMID_GAUSSIAN_FILTER,
+  R2_IMAGE_PYRAMID_NUM_FILTERS
+};
+
+
+
+// Class definition
+
+class R2ImagePyramid {
+ public:
+  // Constructors/destructor
+  R2ImagePyramid(const R2Image& image, int max_levels = 0, int filter = R2_IMAGE_PYRAMID_BOX_FILTER);
+  ~R2ImagePyramid(void);
+
+  // Pyramid properties
+  int NLevels(void) const;
+  const R2Image& Level(int level) const;
+  double Scale(int level) const;
+
+  // Coordinate conversion between level 0 and another level
+  // (pixel centers are at integer coordinates on every level)
+  double ToLevel(double coord, int level) const;
+  double FromLevel(double coord, int level) const;
+
+ private:
+  // Copying would duplicate every level
+  R2ImagePyramid(const R2ImagePyramid& pyramid);
+  R2ImagePyramid& operator=(const R2ImagePyramid& pyramid);
+
+ private:
+  R2Image **levels;
+  int nlevels;
+};
+
+
+
+// Function declarations
+
+// Halves a plane laid out like image pixels (plane[x*height + y]) with the
+// same filters as the pyramid levels
+void R2ReducePlane(const float *plane, int width, int height, std::vector<float>& reduced, 
+  int& reduced_width, int& reduced_height, int filter = R2_IMAGE_PYRAMID_BOX_FILTER);
+
+
+
+// Inline functions
+
+inline int R2ImagePyramid::
+NLevels(void) const
+{
+  // Return number of levels (level 0 is the full resolution image)
+  return nlevels;
+}
+
+
+
+inline const R2Image& R2ImagePyramid::
+Level(int level) const
+{
+  // Return image at given level
+  assert((level >= 0) && (level < nlevels));
+  return *levels[level];
+}
+
+
+
+inline double R2ImagePyramid::
+Scale(int level) const
+{
+  // Return size of a pixel of the given level in level 0 pixels
+  return (double) (1 << level);
+}
+
+
+
+inline double R2ImagePyramid::
+ToLevel(double coord, int level) const
+{
+  // Return coordinate of level 0 position on the given level
+  return (coord + 0.5) / Scale(level) - 0.5;
+}
+
+
+
+inline double R2ImagePyramid::
+FromLevel(double coord, int level) const
+{
+  // Return level 0 coordinate of position on the given level
+  return (coord + 0.5) * Scale(level) - 0.5;
+}
+
+
+
+#endif
@@ -0,0 +1,130 @@
+// Source file for integral image class
+
+
+
+// Include files
+
+#include "R2/R2.h"
+#include "R2IntegralImage.h"
+#include "R2Parallel.h"
+#include <algorithm>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constructors/Destructors
+////////////////////////////////////////////////////////////////////////
+
+// Column x+1 of a table is column x plus the running sum up column x of the
+//    plane, so columns depend on each other.  The columns are split in bands
+//    that are scanned in parallel as if each band started the plane, then the
+//    last column of every band is added to all of the columns after it
+R2IntegralImage::
+R2IntegralImage(const float *plane, int width, int height, int squares)
+  : width(width),
+    height(height)
+{
+  // Allocate tables (column 0 and row 0 stay zero)
+  size_t stride = (size_t) height + 1;
+  sums.assign((width + 1) * stride, 0.0);
+  if (squares) squared_sums.assign((width + 1) * stride, 0.0);
+
+  // Scan bands of columns
+  int nbands = std::max(1, std::min(width, R2NumThreads()));
+  std::vector<int> bands(nbands + 1);
+  for (int b = 0; b <= nbands; b++) bands[b] = (int) ((long long) b * width / nbands);
+  const std::vector<double> zeros(stride, 0.0);
+  R2ParallelFor(0, nbands, nbands, [&](int begin, int end) {
+    for (int b = begin; b < end; b++) {
+      for (int x = bands[b]; x < bands[b+1]; x++) {
+        const float *src = plane + (size_t) x * height;
+        const double *previous = (x == bands[b]) ? zeros.data() : &sums[x * stride];
+        double *dst = &sums[(x + 1) * stride];
+        double sum = 0;
+        for (int y = 0; y < height; y++) {
+          sum += src[y];
+          dst[y + 1] = previous[y + 1] + sum;
+        }
+        if (!squares) continue;
+        previous = (x == bands[b]) ? zeros.data() : &squared_sums[x * stride];
+        dst = &squared_sums[(x + 1) * stride];
+        sum = 0;
+        for (int y = 0; y < height; y++) {
+          sum += (double) src[y] * src[y];
+          dst[y + 1] = previous[y + 1] + sum;
+        }
+      }
+    }
+  });
+  if (nbands == 1) return;
+
+  // Add the sums of the bands before to each band
+  std::vector<double> carries((nbands - 1) * stride), squared_carries((squares) ? (nbands - 1) * stride : 0);
+  for (int b = 1; b < nbands; b++) {
+    const double *last = &sums[bands[b] * stride];
+    double *carry = &carries[(b - 1) * stride];
+    for (size_t y = 0; y < stride; y++) carry[y] = last[y] + ((b > 1) ? carry[(int) y - (int) stride] : 0);
+    if (!squares) continue;
+    last = &squared_sums[bands[b] * stride];
+    carry = &squared_carries[(b - 1) * stride];
+    for (size_t y = 0; y < stride; y++) carry[y] = last[y] + ((b > 1) ? carry[(int) y - (int) stride] : 0);
+  }
+  R2ParallelFor(1, nbands, nbands - 1, [&](int begin, int end) {
+    for (int b = begin; b < end; b++) {
+      const double *carry = &carries[(b - 1) * stride];
+      for (int x = bands[b]; x < bands[b+1]; x++) {
+        double *dst = &sums[(x + 1) * stride];
+        for (size_t y = 0; y < stride; y++) dst[y] += carry[y];
+      }
+      if (!squares) continue;
+      carry = &squared_carries[(b - 1) * stride];
+      for (int x = bands[b]; x < bands[b+1]; x++) {
+        double *dst = &squared_sums[(x + 1) * stride];
+        for (size_t y = 0; y < stride; y++) dst[y] += carry[y];
+      }
+    }
+  });
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Box filter
+////////////////////////////////////////////////////////////////////////
+
+void
+R2BoxFilter(const float *plane, int width, int height, int radius, float *filtered)
+{
+  // Nothing to do for a single pixel box
+  if (radius <= 0) {
+    if (filtered != plane) std::copy(plane, plane + (size_t) width * height, filtered);
+    return;
+  }
+
+  // Sum boxes from the integral image (built first, so filtering may be in place)
+  R2IntegralImage integral(plane, width, height);
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    for (int x = begin; x < end; x++) {
+      int x1 = std::max(x - radius, 0), x2 = std::min(x + radius + 1, width);
+      const double *column1 = integral.SumColumn(x1);
+      const double *column2 = integral.SumColumn(x2);
+      float *dst = filtered + (size_t) x * height;
+
+      // Boxes clipped at the bottom and top
+      int inner1 = std::min(radius, height), inner2 = std::max(inner1, height - radius);
+      for (int y = 0; y < height; y++) {
+        if (y == inner1) y = inner2;
+        if (y == height) break;
+        int y1 = std::max(y - radius, 0), y2 = std::min(y + radius + 1, height);
+        dst[y] = (float) integral.Mean(x1, y1, x2, y2);
+      }
+
+      // Whole boxes (contiguous, so the loop vectorizes)
+      double scale = 1.0 / ((x2 - x1) * (2 * radius + 1));
+      for (int y = inner1; y < inner2; y++) {
+        double sum = column2[y + radius + 1] - column2[y - radius] - column1[y + radius + 1] + column1[y - radius];
+        dst[y] = (float) (sum * scale);
+      }
+    }
+  });
+}
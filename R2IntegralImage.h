@@ -0,0 +1,156 @@
+// Include file for integral image class
+#ifndef R2_INTEGRAL_IMAGE_INCLUDED
+#define R2_INTEGRAL_IMAGE_INCLUDED
+
+
+
+// Include files
+
+#include <vector>
+
+
+
+// Class definition
+
+class R2IntegralImage {
+ public:
+  // Constructor (builds the summed-area table of a width by height plane laid
+  // out like image pixels, plane[x*height + y], and optionally the table of
+  // squared values needed for variances)
+  R2IntegralImage(const float *plane, int width, int height, int squares = 0);
+
+  // Integral image properties
+  int Width(void) const;
+  int Height(void) const;
+  int HasSquares(void) const;
+
+  // Rectangle queries, in constant time, over the pixels x1 <= x < x2 and
+  // y1 <= y < y2 (0 <= x1 <= x2 <= width, 0 <= y1 <= y2 <= height); the
+  // squared sum and the variance need the squares table
+  double Sum(int x1, int y1, int x2, int y2) const;
+  double SquaredSum(int x1, int y1, int x2, int y2) const;
+  double Mean(int x1, int y1, int x2, int y2) const;
+  double Variance(int x1, int y1, int x2, int y2) const;
+
+  // Table access (column x of the summed-area table, whose entry y is the sum
+  // over the pixels left of x and below y, 0 <= x <= width, 0 <= y <= height)
+  const double *SumColumn(int x) const;
+
+ private:
+  double TableSum(const std::vector<double>& table, int x1, int y1, int x2, int y2) const;
+
+ private:
+  std::vector<double> sums;
+  std::vector<double> squared_sums;
+  int width;
+  int height;
+};
+
+
+
+// Function declarations
+
+// Replaces every pixel of a plane (laid out as above) by the mean of the
+// (2*radius + 1) by (2*radius + 1) box around it, in constant time per pixel;
+// boxes are clipped to the plane.  plane and filtered may be the same
+void R2BoxFilter(const float *plane, int width, int height, int radius, float *filtered);
+
+
+
+// Inline functions
+
+inline int R2IntegralImage::
+Width(void) const
+{
+  // Return width of the plane
+  return width;
+}
+
+
+
+inline int R2IntegralImage::
+Height(void) const
+{
+  // Return height of the plane
+  return height;
+}
+
+
+
+inline int R2IntegralImage::
+HasSquares(void) const
+{
+  // Return whether the squares table was built
+  return (squared_sums.empty()) ? 0 : 1;
+}
+
+
+
+inline const double *R2IntegralImage::
+SumColumn(int x) const
+{
+  // Return column x of the summed-area table
+  assert((0 <= x) && (x <= width));
+  return &sums[(size_t) x * (height + 1)];
+}
+
+
+
+inline double R2IntegralImage::
+TableSum(const std::vector<double>& table, int x1, int y1, int x2, int y2) const
+{
+  // Return sum over the rectangle from the four corners of a table
+  // (entry (x, y) is the sum over the pixels left of x and below y)
+  assert((0 <= x1) && (x1 <= x2) && (x2 <= width));
+  assert((0 <= y1) && (y1 <= y2) && (y2 <= height));
+  const double *column1 = &table[(size_t) x1 * (height + 1)];
+  const double *column2 = &table[(size_t) x2 * (height + 1)];
+  return column2[y2] - column2[y1] - column1[y2] + column1[y1];
+}
+
+
+
+inline double R2IntegralImage::
+Sum(int x1, int y1, int x2, int y2) const
+{
+  // Return sum of the pixel values in the rectangle
+  return TableSum(sums, x1, y1, x2, y2);
+}
+
+
+
+inline double R2IntegralImage::
+SquaredSum(int x1, int y1, int x2, int y2) const
+{
+  // Return sum of the squared pixel values in the rectangle
+  assert(HasSquares());
+  return TableSum(squared_sums, x1, y1, x2, y2);
+}
+
+
+
+inline double R2IntegralImage::
+Mean(int x1, int y1, int x2, int y2) const
+{
+  // Return mean of the pixel values in the rectangle (0 if it is empty)
+  int area = (x2 - x1) * (y2 - y1);
+  if (area == 0) return 0;
+  return Sum(x1, y1, x2, y2) / area;
+}
+
+
+
+inline double R2IntegralImage::
+Variance(int x1, int y1, int x2, int y2) const
+{
+  // Return variance of the pixel values in the rectangle (0 if it is empty)
+  int area = (x2 - x1) * (y2 - y1);
+  if (area == 0) return 0;
+  double mean = Sum(x1, y1, x2, y2) / area;
+  double variance = SquaredSum(x1, y1, x2, y2) / area - mean * mean;
+  return (variance > 0) ? variance : 0;
+}
+
+
+
+#endif
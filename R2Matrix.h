@@ -0,0 +1,385 @@
+// Include file for the fixed size matrix classes
+#ifndef R2_MATRIX_INCLUDED
+#define R2_MATRIX_INCLUDED
+
+
+
+// Include files
+
+#include <math.h>
+
+
+
+// Matrix arithmetic is constexpr where the compiler allows loops in constant
+// expressions (C++14); older compilers (e.g. Visual Studio 2015) get inline
+
+#if defined(__cpp_constexpr) && (__cpp_constexpr >= 201304)
+#define R2_MATRIX_CONSTEXPR constexpr
+#else
+#define R2_MATRIX_CONSTEXPR inline
+#endif
+
+
+
+// Class definition
+
+// R x C matrix with entries stored inline (row-major), so small systems
+// live on the stack and loops over their compile-time sizes can be unrolled
+
+template <int R, int C, typename T = double>
+class R2Matrix {
+ public:
+  // Constructors
+  R2_MATRIX_CONSTEXPR R2Matrix(void);
+  R2_MATRIX_CONSTEXPR R2Matrix(const T (&entries)[R][C]);
+  static R2_MATRIX_CONSTEXPR R2Matrix Identity(void);
+
+  // Size
+  static R2_MATRIX_CONSTEXPR int NRows(void) { return R; }
+  static R2_MATRIX_CONSTEXPR int NColumns(void) { return C; }
+
+  // Entry access (M[row][column], or M(i) for vectors)
+  R2_MATRIX_CONSTEXPR const T *operator[](int row) const { return m[row]; }
+  R2_MATRIX_CONSTEXPR T *operator[](int row) { return m[row]; }
+  R2_MATRIX_CONSTEXPR T operator()(int i) const { return m[0][i]; }
+  R2_MATRIX_CONSTEXPR T& operator()(int i) { return m[0][i]; }
+
+  // Properties
+  R2_MATRIX_CONSTEXPR R2Matrix<C, R, T> Transpose(void) const;
+  R2_MATRIX_CONSTEXPR T SquaredNorm(void) const;
+
+  // Assignment operators
+  R2_MATRIX_CONSTEXPR R2Matrix& operator+=(const R2Matrix& matrix);
+  R2_MATRIX_CONSTEXPR R2Matrix& operator-=(const R2Matrix& matrix);
+  R2_MATRIX_CONSTEXPR R2Matrix& operator*=(T a);
+
+  // Arithmetic operators
+  friend R2_MATRIX_CONSTEXPR R2Matrix operator+(R2Matrix a, const R2Matrix& b) { return a += b; }
+  friend R2_MATRIX_CONSTEXPR R2Matrix operator-(R2Matrix a, const R2Matrix& b) { return a -= b; }
+  friend R2_MATRIX_CONSTEXPR R2Matrix operator*(R2Matrix a, T s) { return a *= s; }
+  friend R2_MATRIX_CONSTEXPR R2Matrix operator*(T s, R2Matrix a) { return a *= s; }
+
+ public:
+  // Entries (public, so the matrix can be brace-initialized)
+  T m[R][C];
+};
+
+
+
+// N-vectors are stored as single row matrices, so V(i) == V[0][i]
+
+template <int N, typename T = double>
+using R2Vec = R2Matrix<1, N, T>;
+
+
+
+// Member functions
+
+template <int R, int C, typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<R, C, T>::
+R2Matrix(void)
+  : m()
+{
+  // Entries are zero
+}
+
+
+
+template <int R, int C, typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<R, C, T>::
+R2Matrix(const T (&entries)[R][C])
+  : m()
+{
+  // Copy entries
+  for (int i = 0; i < R; i++)
+    for (int j = 0; j < C; j++)
+      m[i][j] = entries[i][j];
+}
+
+
+
+template <int R, int C, typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<R, C, T> R2Matrix<R, C, T>::
+Identity(void)
+{
+  // Return matrix with ones on the diagonal
+  R2Matrix result;
+  for (int i = 0; i < R && i < C; i++) result.m[i][i] = 1;
+  return result;
+}
+
+
+
+template <int R, int C, typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<C, R, T> R2Matrix<R, C, T>::
+Transpose(void) const
+{
+  // Return transposed matrix
+  R2Matrix<C, R, T> result;
+  for (int i = 0; i < R; i++)
+    for (int j = 0; j < C; j++)
+      result.m[j][i] = m[i][j];
+  return result;
+}
+
+
+
+template <int R, int C, typename T>
+R2_MATRIX_CONSTEXPR T R2Matrix<R, C, T>::
+SquaredNorm(void) const
+{
+  // Return sum of squared entries
+  T sum = 0;
+  for (int i = 0; i < R; i++)
+    for (int j = 0; j < C; j++)
+      sum += m[i][j] * m[i][j];
+  return sum;
+}
+
+
+
+template <int R, int C, typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<R, C, T>& R2Matrix<R, C, T>::
+operator+=(const R2Matrix& matrix)
+{
+  // Add entries
+  for (int i = 0; i < R; i++)
+    for (int j = 0; j < C; j++)
+      m[i][j] += matrix.m[i][j];
+  return *this;
+}
+
+
+
+template <int R, int C, typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<R, C, T>& R2Matrix<R, C, T>::
+operator-=(const R2Matrix& matrix)
+{
+  // Subtract entries
+  for (int i = 0; i < R; i++)
+    for (int j = 0; j < C; j++)
+      m[i][j] -= matrix.m[i][j];
+  return *this;
+}
+
+
+
+template <int R, int C, typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<R, C, T>& R2Matrix<R, C, T>::
+operator*=(T a)
+{
+  // Scale entries
+  for (int i = 0; i < R; i++)
+    for (int j = 0; j < C; j++)
+      m[i][j] *= a;
+  return *this;
+}
+
+
+
+// Matrix products
+
+template <int R, int K, int C, typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<R, C, T>
+operator*(const R2Matrix<R, K, T>& a, const R2Matrix<K, C, T>& b)
+{
+  // Return matrix product a b
+  R2Matrix<R, C, T> result;
+  for (int i = 0; i < R; i++) {
+    for (int j = 0; j < C; j++) {
+      T sum = 0;
+      for (int k = 0; k < K; k++) sum += a.m[i][k] * b.m[k][j];
+      result.m[i][j] = sum;
+    }
+  }
+  return result;
+}
+
+
+
+template <int N, typename T>
+R2_MATRIX_CONSTEXPR T
+R2Dot(const R2Vec<N, T>& a, const R2Vec<N, T>& b)
+{
+  // Return dot product of two vectors
+  T sum = 0;
+  for (int i = 0; i < N; i++) sum += a.m[0][i] * b.m[0][i];
+  return sum;
+}
+
+
+
+// Determinants and inverses of small matrices
+
+template <typename T>
+R2_MATRIX_CONSTEXPR T
+R2Determinant(const R2Matrix<2, 2, T>& a)
+{
+  // Return determinant of 2x2 matrix
+  return a.m[0][0] * a.m[1][1] - a.m[0][1] * a.m[1][0];
+}
+
+
+
+template <typename T>
+R2_MATRIX_CONSTEXPR T
+R2Determinant(const R2Matrix<3, 3, T>& a)
+{
+  // Return determinant of 3x3 matrix (cofactor expansion along first row)
+  return a.m[0][0] * (a.m[1][1] * a.m[2][2] - a.m[1][2] * a.m[2][1])
+       - a.m[0][1] * (a.m[1][0] * a.m[2][2] - a.m[1][2] * a.m[2][0])
+       + a.m[0][2] * (a.m[1][0] * a.m[2][1] - a.m[1][1] * a.m[2][0]);
+}
+
+
+
+template <typename T>
+R2_MATRIX_CONSTEXPR R2Matrix<3, 3, T>
+R2Inverse(const R2Matrix<3, 3, T>& a)
+{
+  // Return inverse of 3x3 matrix (adjugate over determinant);
+  // the caller must check that the determinant is not zero
+  R2Matrix<3, 3, T> result;
+  T invdet = 1 / R2Determinant(a);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      int r0 = (j + 1) % 3, r1 = (j + 2) % 3, c0 = (i + 1) % 3, c1 = (i + 2) % 3;
+      result.m[i][j] = (a.m[r0][c0] * a.m[r1][c1] - a.m[r0][c1] * a.m[r1][c0]) * invdet;
+    }
+  }
+  return result;
+}
+
+
+
+// Decompositions and solvers
+
+template <int N, typename T>
+inline int
+R2Solve(R2Matrix<N, N, T> a, R2Vec<N, T> b, R2Vec<N, T>& x)
+{
+  // Solve a x = b by Gaussian elimination with partial pivoting;
+  // returns 0 if a is (numerically) singular
+  for (int col = 0; col < N; col++) {
+    int pivot = col;
+    for (int row = col + 1; row < N; row++) {
+      if (fabs(a.m[row][col]) > fabs(a.m[pivot][col])) pivot = row;
+    }
+    if (fabs(a.m[pivot][col]) < 1e-12) return 0;
+    if (pivot != col) {
+      for (int k = col; k < N; k++) {
+        T tmp = a.m[col][k]; a.m[col][k] = a.m[pivot][k]; a.m[pivot][k] = tmp;
+      }
+      T tmp = b.m[0][col]; b.m[0][col] = b.m[0][pivot]; b.m[0][pivot] = tmp;
+    }
+    for (int row = col + 1; row < N; row++) {
+      T f = a.m[row][col] / a.m[col][col];
+      for (int k = col; k < N; k++) a.m[row][k] -= f * a.m[col][k];
+      b.m[0][row] -= f * b.m[0][col];
+    }
+  }
+
+  // Back substitution
+  for (int row = N - 1; row >= 0; row--) {
+    T sum = b.m[0][row];
+    for (int k = row + 1; k < N; k++) sum -= a.m[row][k] * x.m[0][k];
+    x.m[0][row] = sum / a.m[row][row];
+  }
+  return 1;
+}
+
+
+
+template <int M, int N, typename T>
+inline void
+R2QR(const R2Matrix<M, N, T>& a, R2Matrix<M, M, T>& q, R2Matrix<M, N, T>& r)
+{
+  // Householder QR decomposition a = q r, with q orthogonal and r upper triangular
+  r = a;
+  q = R2Matrix<M, M, T>::Identity();
+  for (int k = 0; k < N && k < M - 1; k++) {
+    // Householder vector that zeroes column k below the diagonal
+    T v[M];
+    T norm = 0;
+    for (int i = k; i < M; i++) norm += r.m[i][k] * r.m[i][k];
+    norm = sqrt(norm);
+    if (norm == 0) continue;
+    T alpha = (r.m[k][k] > 0) ? -norm : norm;
+    T vnorm = 0;
+    for (int i = k; i < M; i++) {
+      v[i] = r.m[i][k] - ((i == k) ? alpha : 0);
+      vnorm += v[i] * v[i];
+    }
+    if (vnorm == 0) continue;
+
+    // r = (I - 2 v v^T / v^T v) r, q = q (I - 2 v v^T / v^T v)
+    for (int j = 0; j < N; j++) {
+      T s = 0;
+      for (int i = k; i < M; i++) s += v[i] * r.m[i][j];
+      s = 2 * s / vnorm;
+      for (int i = k; i < M; i++) r.m[i][j] -= s * v[i];
+    }
+    for (int i = 0; i < M; i++) {
+      T s = 0;
+      for (int j = k; j < M; j++) s += q.m[i][j] * v[j];
+      s = 2 * s / vnorm;
+      for (int j = k; j < M; j++) q.m[i][j] -= s * v[j];
+    }
+  }
+}
+
+
+
+template <int M, int N, typename T>
+inline void
+R2SVD(const R2Matrix<M, N, T>& a, R2Vec<N, T>& w, R2Matrix<N, N, T>& v)
+{
+  // Singular value decomposition a = u diag(w) v^T by one-sided Jacobi rotations;
+  // singular values are not sorted, and the column of v for the smallest one
+  // spans the (least squares) nullspace of a. Works for M < N too
+  R2Matrix<M, N, T> u = a;
+  v = R2Matrix<N, N, T>::Identity();
+
+  // Rotate pairs of columns of u until all of them are orthogonal
+  for (int sweep = 0; sweep < 60; sweep++) {
+    bool converged = true;
+    for (int p = 0; p < N - 1; p++) {
+      for (int q = p + 1; q < N; q++) {
+        T alpha = 0, beta = 0, gamma = 0;
+        for (int i = 0; i < M; i++) {
+          alpha += u.m[i][p] * u.m[i][p];
+          beta += u.m[i][q] * u.m[i][q];
+          gamma += u.m[i][p] * u.m[i][q];
+        }
+        if (fabs(gamma) <= 1e-15 * sqrt(alpha * beta)) continue;
+        converged = false;
+
+        T zeta = (beta - alpha) / (2 * gamma);
+        T t = ((zeta >= 0) ? 1 : -1) / (fabs(zeta) + sqrt(1 + zeta * zeta));
+        T c = 1 / sqrt(1 + t * t), s = c * t;
+        for (int i = 0; i < M; i++) {
+          T up = u.m[i][p], uq = u.m[i][q];
+          u.m[i][p] = c * up - s * uq;
+          u.m[i][q] = s * up + c * uq;
+        }
+        for (int i = 0; i < N; i++) {
+          T vp = v.m[i][p], vq = v.m[i][q];
+          v.m[i][p] = c * vp - s * vq;
+          v.m[i][q] = s * vp + c * vq;
+        }
+      }
+    }
+    if (converged) break;
+  }
+
+  // Singular values are the norms of the orthogonalized columns
+  for (int j = 0; j < N; j++) {
+    T sum = 0;
+    for (int i = 0; i < M; i++) sum += u.m[i][j] * u.m[i][j];
+    w.m[0][j] = sqrt(sum);
+  }
+}
+
+
+
+#endif
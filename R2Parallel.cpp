@@ -0,0 +1,181 @@
+// Source file for the parallel loop helpers
+
+
+
+// Include files
+
+#include "R2Parallel.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Thread pool
+////////////////////////////////////////////////////////////////////////
+
+// Workers are started on first use and live for the rest of the program,
+//    so per-frame loops do not pay for creating threads
+class R2ThreadPool {
+ public:
+  R2ThreadPool(void);
+  ~R2ThreadPool(void);
+  int NThreads(void) const { return (int) workers.size() + 1; }
+  void Run(int nbands, const std::function<void(int)>& band);
+
+ private:
+  void WorkerLoop(void);
+  bool RunOneBand(std::unique_lock<std::mutex>& lock);
+
+ private:
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+  const std::function<void(int)> *job;
+  int nextBand, nbands, pending;
+  unsigned int generation;
+  bool stop;
+};
+
+
+// Set while a thread is executing a band, to run nested loops serially
+static thread_local bool R2in_parallel_band = false;
+
+// Serializes jobs submitted from different threads
+static std::mutex R2pool_job_mutex;
+
+
+
+R2ThreadPool::
+R2ThreadPool(void)
+  : job(NULL),
+    nextBand(0),
+    nbands(0),
+    pending(0),
+    generation(0),
+    stop(false)
+{
+  // The calling thread works too, so start one worker less than there are cores
+  unsigned int ncores = std::thread::hardware_concurrency();
+  for (unsigned int i = 1; i < ncores; i++) {
+    workers.push_back(std::thread(&R2ThreadPool::WorkerLoop, this));
+  }
+}
+
+
+
+R2ThreadPool::
+~R2ThreadPool(void)
+{
+  // Wake up and join all workers
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  wake.notify_all();
+  for (unsigned int i = 0; i < workers.size(); i++) workers[i].join();
+}
+
+
+
+bool R2ThreadPool::
+RunOneBand(std::unique_lock<std::mutex>& lock)
+{
+  // Take the next band of the current job, if any, and run it unlocked
+  if (!job || nextBand >= nbands) return false;
+  int band = nextBand++;
+  const std::function<void(int)> *current = job;
+  lock.unlock();
+  R2in_parallel_band = true;
+  (*current)(band);
+  R2in_parallel_band = false;
+  lock.lock();
+  if (--pending == 0) done.notify_all();
+  return true;
+}
+
+
+
+void R2ThreadPool::
+WorkerLoop(void)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  unsigned int seen = generation;
+  while (true) {
+    wake.wait(lock, [&] { return stop || generation != seen; });
+    if (stop) return;
+    seen = generation;
+    while (RunOneBand(lock)) {}
+  }
+}
+
+
+
+void R2ThreadPool::
+Run(int count, const std::function<void(int)>& band)
+{
+  // Publish the job, help running it, then wait for the bands still in flight
+  std::unique_lock<std::mutex> lock(mutex);
+  job = &band;
+  nextBand = 0;
+  nbands = count;
+  pending = count;
+  generation++;
+  wake.notify_all();
+  while (RunOneBand(lock)) {}
+  done.wait(lock, [&] { return pending == 0; });
+  job = NULL;
+}
+
+
+
+static R2ThreadPool& 
+ThreadPool(void)
+{
+  // Pool shared by all parallel loops (one job runs at a time)
+  static R2ThreadPool pool;
+  return pool;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Parallel loops
+////////////////////////////////////////////////////////////////////////
+
+int 
+R2NumThreads(void)
+{
+  // Return number of threads in the pool, including the caller
+  return ThreadPool().NThreads();
+}
+
+
+
+void 
+R2ParallelFor(int begin, int end, int nbands, const std::function<void(int, int)>& body)
+{
+  // Check arguments
+  int n = end - begin;
+  if (n <= 0) return;
+  if (nbands > n) nbands = n;
+  if (nbands < 1) nbands = 1;
+
+  // Run serially if there is nothing to split or we are already inside a band
+  if (nbands == 1 || R2in_parallel_band || R2NumThreads() == 1) {
+    body(begin, end);
+    return;
+  }
+
+  // Run bands of (nearly) equal size on the pool
+  std::function<void(int)> band = [&](int b) {
+    int bandBegin = begin + (int) ((long long) n * b / nbands);
+    int bandEnd = begin + (int) ((long long) n * (b + 1) / nbands);
+    body(bandBegin, bandEnd);
+  };
+  std::lock_guard<std::mutex> lock(R2pool_job_mutex);
+  ThreadPool().Run(nbands, band);
+}
@@ -0,0 +1,25 @@
+// Include file for the parallel loop helpers
+#ifndef R2_PARALLEL_INCLUDED
+#define R2_PARALLEL_INCLUDED
+
+
+
+// Include files
+
+#include <functional>
+
+
+
+// Function declarations
+
+// Returns the number of threads work is spread over (at least 1)
+int R2NumThreads(void);
+
+// Splits [begin, end) into nbands contiguous bands and calls body(bandBegin, bandEnd)
+// for each of them on a pool of worker threads, returning once all bands are done.
+// Calls made from inside a band run serially on the calling thread
+void R2ParallelFor(int begin, int end, int nbands, const std::function<void(int, int)>& body);
+
+
+
+#endif
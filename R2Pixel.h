@@ -3,6 +3,15 @@
 #define R2_PIXEL_INCLUDED
 
 
+// Constant definitions
+
+// Weights of the red, green and blue components in the luminance
+
+#define R2_PIXEL_RED_LUMINANCE 0.30
+#define R2_PIXEL_GREEN_LUMINANCE 0.59
+#define R2_PIXEL_BLUE_LUMINANCE 0.11
+
+
 // Class definition 
 
 class R2Pixel {
@@ -55,6 +64,8 @@ class R2Pixel {
   friend R2Pixel operator/(const R2Pixel& pixel, double scale);
 
  private:
+  // The components must stay the only member, as a bare array: the pixels of
+  // an image are processed as one flat array of doubles (R2PixelOperations)
   double c[4];
 };
 
@@ -169,7 +180,7 @@ inline double R2Pixel::
 Luminance(void) const
 {
   // Return luminance
-  return 0.30 * c[0] + 0.59 * c[1] + 0.11 * c[2];
+  return R2_PIXEL_RED_LUMINANCE * c[0] + R2_PIXEL_GREEN_LUMINANCE * c[1] + R2_PIXEL_BLUE_LUMINANCE * c[2];
 }
 
 
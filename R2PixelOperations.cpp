@@ -0,0 +1,236 @@
+// Source file for fused per-pixel operations
+
+
+
+// Include files
+
+#include "R2/R2.h"
+#include "R2Pixel.h"
+#include "R2Image.h"
+#include "R2PixelOperations.h"
+#include "R2Parallel.h"
+#include <algorithm>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constructors/Destructors
+////////////////////////////////////////////////////////////////////////
+
+R2PixelOperations::
+R2PixelOperations(void)
+{
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Recording
+////////////////////////////////////////////////////////////////////////
+
+// Composes a color matrix after the operations so far: into the last step if
+//    it does not clamp (clamping between them keeps them apart), or as a new step
+void R2PixelOperations::
+Multiply(const double matrix[4][4])
+{
+  if (steps.empty() || steps.back().clamp) {
+    Step step;
+    for (int i = 0; i < 4; i++) {
+      for (int j = 0; j < 4; j++) step.matrix[i][j] = (i == j) ? 1 : 0;
+    }
+    step.clamp = 0;
+    step.diagonal = 1;
+    step.alpha = 0;
+    steps.push_back(step);
+  }
+
+  double (*last)[4] = steps.back().matrix;
+  double product[4][4];
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      product[i][j] = 0;
+      for (int k = 0; k < 4; k++) product[i][j] += matrix[i][k] * last[k][j];
+    }
+  }
+  int diagonal = 1, alpha = 0;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      last[i][j] = product[i][j];
+      if ((i != j) && (product[i][j] != 0)) diagonal = 0;
+      if (((i == 3) || (j == 3)) && (product[i][j] != ((i == j) ? 1 : 0))) alpha = 1;
+    }
+  }
+  steps.back().diagonal = diagonal;
+  steps.back().alpha = alpha;
+}
+
+
+
+void R2PixelOperations::
+Scale(double factor)
+{
+  // Multiply the color components by the factor (as R2Pixel::operator*=, alpha is kept)
+  double matrix[4][4] = { { factor, 0, 0, 0 }, { 0, factor, 0, 0 }, { 0, 0, factor, 0 }, { 0, 0, 0, 1 } };
+  Multiply(matrix);
+}
+
+
+
+void R2PixelOperations::
+ScaleChannel(int channel, double factor)
+{
+  // Multiply one component by the factor
+  assert((channel >= 0) && (channel < R2_IMAGE_NUM_CHANNELS));
+  double matrix[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+  matrix[channel][channel] = factor;
+  Multiply(matrix);
+}
+
+
+
+void R2PixelOperations::
+Saturate(double factor)
+{
+  // Move the color channels away from the luminance of the pixel (or toward
+  // it, for factors below 1) by the factor, so the luminance is unchanged;
+  // the weights are those of R2Pixel::Luminance
+  static const double weights[3] = { R2_PIXEL_RED_LUMINANCE, R2_PIXEL_GREEN_LUMINANCE, R2_PIXEL_BLUE_LUMINANCE };
+  double matrix[4][4] = { { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 1 } };
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) matrix[i][j] = (1 - factor) * weights[j] + ((i == j) ? factor : 0);
+  }
+  Multiply(matrix);
+}
+
+
+
+void R2PixelOperations::
+Clamp(void)
+{
+  // Clamp the components between 0 and 1 after the operations so far
+  if (steps.empty()) {
+    double identity[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+    Multiply(identity);
+  }
+  steps.back().clamp = 1;
+}
+
+
+
+void R2PixelOperations::
+Clear(void)
+{
+  // Forget all operations
+  steps.clear();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Applying
+////////////////////////////////////////////////////////////////////////
+
+// Number of pixels taken through all steps at a time (16KB, so they stay
+// in the L1 cache from one step to the next)
+#define APPLY_CHUNK_PIXELS 512
+
+
+
+// Multiplies the components of n pixels, stored as 4 doubles each, by
+//    scale[k], and clamps them if CLAMP is set.  The four components of a
+//    pixel are isomorphic, so they are done as two SSE2 vectors, with the
+//    clamp as min/max instructions rather than branches
+template <int CLAMP>
+static void
+ScaleValues(double *values, size_t n, const double scale[4])
+{
+  const double s0 = scale[0], s1 = scale[1], s2 = scale[2], s3 = scale[3];
+  for (size_t i = 0; i < 4 * n; i += 4) {
+    double *p = values + i;
+    double c0 = s0 * p[0], c1 = s1 * p[1], c2 = s2 * p[2], c3 = s3 * p[3];
+    if (CLAMP) {
+      c0 = std::min(std::max(c0, 0.0), 1.0);
+      c1 = std::min(std::max(c1, 0.0), 1.0);
+      c2 = std::min(std::max(c2, 0.0), 1.0);
+      c3 = std::min(std::max(c3, 0.0), 1.0);
+    }
+    p[0] = c0, p[1] = c1, p[2] = c2, p[3] = c3;
+  }
+}
+
+
+
+// Multiplies n pixels by a color matrix, and clamps them if CLAMP is set
+//    (the matrix is held in locals, so it stays in registers).  Without ALPHA,
+//    the matrix must leave alpha as it is and keep it out of the colors
+template <int CLAMP, int ALPHA>
+static void
+TransformValues(double *values, size_t n, const double matrix[4][4])
+{
+  const double m00 = matrix[0][0], m01 = matrix[0][1], m02 = matrix[0][2], m03 = matrix[0][3];
+  const double m10 = matrix[1][0], m11 = matrix[1][1], m12 = matrix[1][2], m13 = matrix[1][3];
+  const double m20 = matrix[2][0], m21 = matrix[2][1], m22 = matrix[2][2], m23 = matrix[2][3];
+  const double m30 = matrix[3][0], m31 = matrix[3][1], m32 = matrix[3][2], m33 = matrix[3][3];
+  for (size_t i = 0; i < 4 * n; i += 4) {
+    double *p = values + i;
+    double r = p[0], g = p[1], b = p[2], a = p[3];
+    double c0 = m00 * r + m01 * g + m02 * b;
+    double c1 = m10 * r + m11 * g + m12 * b;
+    double c2 = m20 * r + m21 * g + m22 * b;
+    double c3 = a;
+    if (ALPHA) {
+      c0 += m03 * a;
+      c1 += m13 * a;
+      c2 += m23 * a;
+      c3 = m30 * r + m31 * g + m32 * b + m33 * a;
+    }
+    if (CLAMP) {
+      c0 = std::min(std::max(c0, 0.0), 1.0);
+      c1 = std::min(std::max(c1, 0.0), 1.0);
+      c2 = std::min(std::max(c2, 0.0), 1.0);
+      c3 = std::min(std::max(c3, 0.0), 1.0);
+    }
+    p[0] = c0, p[1] = c1, p[2] = c2, p[3] = c3;
+  }
+}
+
+
+
+void R2PixelOperations::
+Apply(R2Image& image) const
+{
+  // Nothing to do without operations
+  if (IsEmpty()) return;
+
+  // The pixels of a band of columns are contiguous, and each pixel is its
+  // four components, so a band is processed as an array of doubles: in chunks
+  // that go through every step while they are in cache, with one kernel per
+  // step that runs over the whole chunk
+  static_assert(sizeof(R2Pixel) == R2_IMAGE_NUM_CHANNELS * sizeof(double), "R2Pixel must be four bare doubles");
+  size_t height = image.Height();
+  R2ParallelFor(0, image.Width(), R2NumThreads(), [&](int begin, int end) {
+    if (begin == end) return;
+    double *values = &image[begin][0][0];
+    size_t npixels = (end - begin) * height;
+    for (size_t start = 0; start < npixels; start += APPLY_CHUNK_PIXELS) {
+      double *chunk = values + 4 * start;
+      size_t n = std::min((size_t) APPLY_CHUNK_PIXELS, npixels - start);
+      for (size_t s = 0; s < steps.size(); s++) {
+        const Step& step = steps[s];
+        if (step.diagonal) {
+          double scale[4] = { step.matrix[0][0], step.matrix[1][1], step.matrix[2][2], step.matrix[3][3] };
+          if (step.clamp) ScaleValues<1>(chunk, n, scale);
+          else ScaleValues<0>(chunk, n, scale);
+        }
+        else if (step.alpha) {
+          if (step.clamp) TransformValues<1, 1>(chunk, n, step.matrix);
+          else TransformValues<0, 1>(chunk, n, step.matrix);
+        }
+        else {
+          if (step.clamp) TransformValues<1, 0>(chunk, n, step.matrix);
+          else TransformValues<0, 0>(chunk, n, step.matrix);
+        }
+      }
+    }
+  });
+}
@@ -0,0 +1,89 @@
+// Include file for fused per-pixel operations
+#ifndef R2_PIXEL_OPERATIONS_INCLUDED
+#define R2_PIXEL_OPERATIONS_INCLUDED
+
+
+
+// Include files
+
+#include <vector>
+#include <algorithm>
+
+
+
+// Class definition
+
+class R2PixelOperations {
+ public:
+  // Constructor (no operations)
+  R2PixelOperations(void);
+
+  // Properties
+  int IsEmpty(void) const;
+
+  // Recording operations, to be applied in the order they are recorded.
+  // Consecutive linear operations are composed into one color matrix, so
+  // applying them costs one matrix product per clamp
+  void Scale(double factor);
+  void ScaleChannel(int channel, double factor);
+  void Saturate(double factor);
+  void Clamp(void);
+  void Clear(void);
+
+  // Applying the operations, to a pixel or to every pixel of an image in one pass
+  void Apply(R2Pixel& pixel) const;
+  void Apply(R2Image& image) const;
+
+ private:
+  struct Step {
+    double matrix[4][4];
+    int diagonal;
+    int alpha;
+    int clamp;
+  };
+  void Multiply(const double matrix[4][4]);
+  std::vector<Step> steps;
+};
+
+
+
+// Inline functions
+
+inline int R2PixelOperations::
+IsEmpty(void) const
+{
+  // Return whether there is nothing to apply
+  return (steps.empty()) ? 1 : 0;
+}
+
+
+
+inline void R2PixelOperations::
+Apply(R2Pixel& pixel) const
+{
+  // Apply every step to the components held apart (so the pixel is
+  // read and written once): a color matrix, then maybe a clamp
+  double c[4] = { pixel[0], pixel[1], pixel[2], pixel[3] };
+  for (size_t s = 0; s < steps.size(); s++) {
+    const Step& step = steps[s];
+    const double (*m)[4] = step.matrix;
+    if (step.diagonal) {
+      for (int i = 0; i < 4; i++) c[i] *= m[i][i];
+    }
+    else {
+      double r = m[0][0] * c[0] + m[0][1] * c[1] + m[0][2] * c[2] + m[0][3] * c[3];
+      double g = m[1][0] * c[0] + m[1][1] * c[1] + m[1][2] * c[2] + m[1][3] * c[3];
+      double b = m[2][0] * c[0] + m[2][1] * c[1] + m[2][2] * c[2] + m[2][3] * c[3];
+      double a = m[3][0] * c[0] + m[3][1] * c[1] + m[3][2] * c[2] + m[3][3] * c[3];
+      c[0] = r, c[1] = g, c[2] = b, c[3] = a;
+    }
+    if (step.clamp) {
+      for (int i = 0; i < 4; i++) c[i] = std::min(std::max(c[i], 0.0), 1.0);
+    }
+  }
+  for (int i = 0; i < 4; i++) pixel[i] = c[i];
+}
+
+
+
+#endif
@@ -0,0 +1,254 @@
+// Source file for image registration
+
+
+
+// Include files
+
+#include "R2/R2.h"
+#include "R2Pixel.h"
+#include "R2Image.h"
+#include "R2ImagePyramid.h"
+#include "R2Homography.h"
+#include "R2Feature.h"
+#include "R2FFT.h"
+#include "R2Registration.h"
+#include "R2Parallel.h"
+#include <algorithm>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Luminance pyramids
+////////////////////////////////////////////////////////////////////////
+
+// One level of a luminance pyramid
+struct R2LuminanceLevel {
+  std::vector<float> plane;
+  int width, height;
+};
+
+
+
+// Returns the number of levels needed to bring an image of the given size
+// down to coarsest_size pixels (but not below 16 pixels on either side)
+static int
+CountLevels(int width, int height, int coarsest_size)
+{
+  int nlevels = 1;
+  while ((std::max(width, height) > coarsest_size) && (std::min(width, height) >= 32)) {
+    width /= 2;
+    height /= 2;
+    nlevels++;
+  }
+  return nlevels;
+}
+
+
+
+// Builds the Gaussian pyramid of the luminance of an image
+static void
+BuildLuminancePyramid(const R2Image& image, int nlevels, std::vector<R2LuminanceLevel>& levels)
+{
+  levels.resize(nlevels);
+  R2ComputeLuminance(image, levels[0].plane);
+  levels[0].width = image.Width();
+  levels[0].height = image.Height();
+  for (int l = 1; l < nlevels; l++) {
+    R2ReducePlane(levels[l-1].plane.data(), levels[l-1].width, levels[l-1].height,
+      levels[l].plane, levels[l].width, levels[l].height, R2_IMAGE_PYRAMID_GAUSSIAN_FILTER);
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Translation
+////////////////////////////////////////////////////////////////////////
+
+// Smallest phase correlation peak accepted on the coarsest level
+#define TRANSLATION_MIN_PEAK 0.02
+
+// Lucas-Kanade refinement: iterations per level, the update size at which
+// they stop, and the number of pixels sampled per level (the finer levels
+// are sampled on a sparser grid)
+#define TRANSLATION_ITERATIONS 5
+#define TRANSLATION_CONVERGENCE 0.01
+#define TRANSLATION_SAMPLES 262144
+
+
+
+// Returns the bilinearly interpolated value of a plane, or a negative value
+// if (u, v) is not inside it
+static inline float
+SamplePlane(const R2LuminanceLevel& level, double u, double v)
+{
+  if ((u < 0) || (v < 0) || (u > level.width - 1) || (v > level.height - 1)) return -1.0f;
+  int x = std::min((int) u, level.width - 2), y = std::min((int) v, level.height - 2);
+  float s = (float) (u - x), t = (float) (v - y);
+  const float *p0 = &level.plane[(size_t) x * level.height + y];
+  const float *p1 = p0 + level.height;
+  return (1 - s) * ((1 - t) * p0[0] + t * p0[1]) + s * ((1 - t) * p1[0] + t * p1[1]);
+}
+
+
+
+// Refines the translation (dx, dy) between two levels by inverse compositional
+// Lucas-Kanade: each iteration linearizes the first plane around every sampled
+// pixel and solves the 2x2 normal equations for the correction
+static void
+RefineTranslation(const R2LuminanceLevel& level, const R2LuminanceLevel& otherLevel, double& dx, double& dy)
+{
+  int step = 1;
+  while ((double) level.width * level.height / (step * step) > TRANSLATION_SAMPLES) step++;
+  int ncolumns = (level.width - 2 + step - 1) / step;
+  int nbands = std::max(1, std::min(ncolumns, 4 * R2NumThreads()));
+
+  for (int iteration = 0; iteration < TRANSLATION_ITERATIONS; iteration++) {
+    // Accumulate the normal equations, with partial sums per band
+    std::vector<double> sums(5 * nbands, 0.0);
+    R2ParallelFor(0, nbands, nbands, [&](int begin, int end) {
+      for (int b = begin; b < end; b++) {
+        double *s = &sums[5 * b];
+        for (int c = b; c < ncolumns; c += nbands) {
+          int x = 1 + c * step;
+          const float *column = &level.plane[(size_t) x * level.height];
+          for (int y = 1; y < level.height - 1; y += step) {
+            float other = SamplePlane(otherLevel, x + dx, y + dy);
+            if (other < 0) continue;
+            double gx = 0.5 * (column[y + level.height] - column[y - level.height]);
+            double gy = 0.5 * (column[y + 1] - column[y - 1]);
+            double e = other - column[y];
+            s[0] += gx * gx; s[1] += gx * gy; s[2] += gy * gy;
+            s[3] += gx * e; s[4] += gy * e;
+          }
+        }
+      }
+    });
+    double s[5] = { 0, 0, 0, 0, 0 };
+    for (int b = 0; b < nbands; b++)
+      for (int k = 0; k < 5; k++)
+        s[k] += sums[5*b + k];
+
+    // Solve for the correction of the first plane, and apply its inverse
+    double det = s[0] * s[2] - s[1] * s[1];
+    if (fabs(det) < 1e-12) return;
+    double ddx = (s[2] * s[3] - s[1] * s[4]) / det;
+    double ddy = (s[0] * s[4] - s[1] * s[3]) / det;
+    dx -= ddx;
+    dy -= ddy;
+    if (ddx * ddx + ddy * ddy < TRANSLATION_CONVERGENCE * TRANSLATION_CONVERGENCE) return;
+  }
+}
+
+
+
+int
+R2RegisterTranslation(const R2Image& image, const R2Image& otherImage, double& dx, double& dy, int coarsest_size)
+{
+  // Build pyramids with the same number of levels
+  int nlevels = std::min(CountLevels(image.Width(), image.Height(), coarsest_size),
+    CountLevels(otherImage.Width(), otherImage.Height(), coarsest_size));
+  std::vector<R2LuminanceLevel> levels, otherLevels;
+  BuildLuminancePyramid(image, nlevels, levels);
+  BuildLuminancePyramid(otherImage, nlevels, otherLevels);
+
+  // Find the translation on the coarsest level, where it is only a few pixels
+  const R2LuminanceLevel& top = levels[nlevels-1], &otherTop = otherLevels[nlevels-1];
+  double peak = R2PhaseCorrelate(top.plane.data(), top.width, top.height,
+    otherTop.plane.data(), otherTop.width, otherTop.height, dx, dy);
+  if (peak < TRANSLATION_MIN_PEAK) return 0;
+
+  // Refine it on each finer level (displacements double from one to the next)
+  for (int l = nlevels - 2; l >= 0; l--) {
+    dx *= 2;
+    dy *= 2;
+    RefineTranslation(levels[l], otherLevels[l], dx, dy);
+  }
+
+  // Return success
+  return 1;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Homography
+////////////////////////////////////////////////////////////////////////
+
+// RANSAC inlier thresholds on the coarsest and on the finer levels (in pixels
+// of the level), the search radius around predicted positions on the finer
+// levels, and the number of inliers needed to update the estimate there
+#define HOMOGRAPHY_COARSE_THRESHOLD 2.0
+#define HOMOGRAPHY_FINE_THRESHOLD 1.5
+#define HOMOGRAPHY_SEARCH_RADIUS 6.0
+#define HOMOGRAPHY_MIN_INLIERS 12
+
+
+
+// Detects and describes the features of a level
+static void
+DescribeLevel(const R2LuminanceLevel& level, std::vector<R2Feature>& features, std::vector<unsigned char>& descriptors)
+{
+  R2DetectFeatures(level.plane.data(), level.width, level.height, features);
+  R2ComputeDescriptors(level.plane.data(), level.width, level.height, features, descriptors);
+}
+
+
+
+int
+R2RegisterHomography(const R2Image& image, const R2Image& otherImage, R2Homography& H, int coarsest_size)
+{
+  // Build pyramids with the same number of levels
+  int nlevels = std::min(CountLevels(image.Width(), image.Height(), coarsest_size),
+    CountLevels(otherImage.Width(), otherImage.Height(), coarsest_size));
+  std::vector<R2LuminanceLevel> levels, otherLevels;
+  BuildLuminancePyramid(image, nlevels, levels);
+  BuildLuminancePyramid(otherImage, nlevels, otherLevels);
+
+  // Match features anywhere on the coarsest level, and fit a homography
+  std::vector<R2Feature> features, otherFeatures;
+  std::vector<unsigned char> descriptors, otherDescriptors;
+  std::vector<R2FeatureMatch> matches;
+  std::vector<R2Point> points, otherPoints;
+  DescribeLevel(levels[nlevels-1], features, descriptors);
+  DescribeLevel(otherLevels[nlevels-1], otherFeatures, otherDescriptors);
+  R2MatchFeatures(features, descriptors, otherFeatures, otherDescriptors, matches);
+  for (unsigned int i = 0; i < matches.size(); i++) {
+    points.push_back(features[matches[i].index1].position);
+    otherPoints.push_back(otherFeatures[matches[i].index2].position);
+  }
+  R2Homography estimate;
+  if (!R2EstimateHomography(points.data(), otherPoints.data(), (int) points.size(), estimate, HOMOGRAPHY_COARSE_THRESHOLD, 1)) return 0;
+
+  // Refine it on each finer level, only matching features close to where the
+  // current estimate maps them
+  const double up[3][3] = { { 2, 0, 0.5 }, { 0, 2, 0.5 }, { 0, 0, 1 } };
+  const double down[3][3] = { { 0.5, 0, -0.25 }, { 0, 0.5, -0.25 }, { 0, 0, 1 } };
+  for (int l = nlevels - 2; l >= 0; l--) {
+    // Express the estimate in the pixels of this level
+    estimate = R2Homography(R2Matrix<3, 3, double>(up) * estimate * R2Matrix<3, 3, double>(down));
+
+    // Match features near their predicted positions
+    DescribeLevel(levels[l], features, descriptors);
+    DescribeLevel(otherLevels[l], otherFeatures, otherDescriptors);
+    std::vector<R2Feature> predicted(features);
+    for (unsigned int i = 0; i < predicted.size(); i++) predicted[i].position = estimate.Transform(features[i].position);
+    R2MatchFeatures(predicted, descriptors, otherFeatures, otherDescriptors, matches,
+      R2_FEATURE_MATCH_RATIO, 1, HOMOGRAPHY_SEARCH_RADIUS);
+    points.clear();
+    otherPoints.clear();
+    for (unsigned int i = 0; i < matches.size(); i++) {
+      points.push_back(features[matches[i].index1].position);
+      otherPoints.push_back(otherFeatures[matches[i].index2].position);
+    }
+
+    // Refit (keeping the previous estimate if too few matches agree)
+    R2Homography refined;
+    int ninliers = R2EstimateHomography(points.data(), otherPoints.data(), (int) points.size(), refined, HOMOGRAPHY_FINE_THRESHOLD, 1);
+    if (ninliers >= HOMOGRAPHY_MIN_INLIERS) estimate = refined;
+  }
+
+  // Return success
+  H = estimate;
+  return 1;
+}
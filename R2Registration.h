@@ -0,0 +1,36 @@
+// Include file for image registration
+#ifndef R2_REGISTRATION_INCLUDED
+#define R2_REGISTRATION_INCLUDED
+
+
+
+// Constant definitions
+
+#define R2_REGISTRATION_TRANSLATION_SIZE 256
+#define R2_REGISTRATION_HOMOGRAPHY_SIZE 640
+
+
+
+// Function declarations
+
+// Both functions work coarse to fine on Gaussian pyramids of the luminance of
+// the images: the motion is estimated on a level no larger than the given size
+// (where large displacements are only a few pixels), then refined on each
+// finer level starting from the estimate of the level above.  Both return 0
+// if the images could not be registered
+
+// Estimates the translation (dx, dy) such that point (x, y) of image
+// corresponds to (x + dx, y + dy) in otherImage: phase correlation on the
+// coarsest level, then Lucas-Kanade refinement on the finer ones
+int R2RegisterTranslation(const R2Image& image, const R2Image& otherImage, double& dx, double& dy,
+  int coarsest_size = R2_REGISTRATION_TRANSLATION_SIZE);
+
+// Estimates the homography H mapping points of image to points of otherImage:
+// matched features with RANSAC on the coarsest level, then features matched
+// only near their predicted positions on the finer ones
+int R2RegisterHomography(const R2Image& image, const R2Image& otherImage, R2Homography& H,
+  int coarsest_size = R2_REGISTRATION_HOMOGRAPHY_SIZE);
+
+
+
+#endif
@@ -0,0 +1,149 @@
+// Source file for Gaussian scale space class
+
+
+
+// Include files
+
+#include "R2/R2.h"
+#include "R2Pixel.h"
+#include "R2Image.h"
+#include "R2ScaleSpace.h"
+#include "R2Filter.h"
+#include "R2Parallel.h"
+#include <algorithm>
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Constructors/Destructors
+////////////////////////////////////////////////////////////////////////
+
+R2ScaleSpace::
+R2ScaleSpace(const float *plane, int width, int height, double sigma, int nlevels, double factor)
+  : levels(std::max(nlevels, 1)),
+    sigmas(std::max(nlevels, 1)),
+    factor(factor),
+    width(width),
+    height(height)
+{
+  // Blur the plane for the first level, then each level from the one below by
+  // the Gaussian that adds up with its blur to the blur of the next level
+  size_t npixels = (size_t) width * height;
+  sigmas[0] = sigma;
+  levels[0].resize(npixels);
+  R2GaussianBlur(plane, width, height, sigma, levels[0].data());
+  for (int i = 1; i < NLevels(); i++) {
+    sigmas[i] = sigmas[i-1] * factor;
+    levels[i].resize(npixels);
+    double increment = sqrt(sigmas[i] * sigmas[i] - sigmas[i-1] * sigmas[i-1]);
+    R2GaussianBlur(levels[i-1].data(), width, height, increment, levels[i].data());
+  }
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Differences of Gaussians
+////////////////////////////////////////////////////////////////////////
+
+void R2ScaleSpace::
+DifferenceOfGaussians(int level, float *dog) const
+{
+  // G(k sigma) - G(sigma) is about (k - 1) sigma^2 times the Laplacian of G(sigma)
+  assert((level >= 0) && (level < NLevels() - 1));
+  const float *lower = Level(level), *upper = Level(level + 1);
+  const float scale = (float) (1.0 / (factor - 1));
+  R2ParallelFor(0, width, R2NumThreads(), [&](int begin, int end) {
+    for (size_t i = (size_t) begin * height; i < (size_t) end * height; i++) {
+      dog[i] = scale * (upper[i] - lower[i]);
+    }
+  });
+}
+
+
+
+////////////////////////////////////////////////////////////////////////
+// Blob detection
+////////////////////////////////////////////////////////////////////////
+
+// Returns whether v is larger (or, with sign -1, smaller) than the 9 values of
+//    the 3x3 neighborhood at y of the three columns (skipping the center one
+//    if center is set)
+static inline bool
+Exceeds(float v, int sign, const float *columns[3], int y, bool center)
+{
+  for (int i = 0; i < 3; i++) {
+    for (int j = y - 1; j <= y + 1; j++) {
+      if (center && (i == 1) && (j == y)) continue;
+      if (sign * v <= sign * columns[i][j]) return false;
+    }
+  }
+  return true;
+}
+
+
+
+// Orders blobs from strongest to weakest
+static bool
+StrongerBlob(const R2Blob& a, const R2Blob& b)
+{
+  return fabs(a.response) > fabs(b.response);
+}
+
+
+
+int R2ScaleSpace::
+DetectBlobs(std::vector<R2Blob>& blobs, double threshold) const
+{
+  // Initialize result
+  blobs.clear();
+  int ndogs = NLevels() - 1;
+  if ((ndogs < 3) || (width < 3) || (height < 3)) return 0;
+
+  // Compute the differences of Gaussians of all levels
+  size_t npixels = (size_t) width * height;
+  std::vector<float> dogs(ndogs * npixels);
+  for (int d = 0; d < ndogs; d++) DifferenceOfGaussians(d, &dogs[d * npixels]);
+
+  // Find the extrema in position and scale, in bands of columns in parallel
+  int nbands = std::min(width - 2, 4 * R2NumThreads());
+  std::vector< std::vector<R2Blob> > candidates(nbands);
+  R2ParallelFor(0, nbands, nbands, [&](int begin, int end) {
+    for (int b = begin; b < end; b++) {
+      int x0 = 1 + (int) ((long long) b * (width - 2) / nbands);
+      int x1 = 1 + (int) ((long long) (b + 1) * (width - 2) / nbands);
+      for (int d = 1; d < ndogs - 1; d++) {
+        for (int x = x0; x < x1; x++) {
+          const float *scales[3][3];
+          for (int s = 0; s < 3; s++) {
+            const float *column = &dogs[(d - 1 + s) * npixels + (size_t) x * height];
+            scales[s][0] = column - height;
+            scales[s][1] = column;
+            scales[s][2] = column + height;
+          }
+          for (int y = 1; y < height - 1; y++) {
+            float v = scales[1][1][y];
+            if (fabs(v) <= threshold) continue;
+            int sign = (v > 0) ? 1 : -1;
+            if (!Exceeds(v, sign, scales[1], y, true)) continue;
+            if (!Exceeds(v, sign, scales[0], y, false)) continue;
+            if (!Exceeds(v, sign, scales[2], y, false)) continue;
+            // The difference matches the Laplacian between the two scales best
+            R2Blob blob;
+            blob.position = R2Point(x, y);
+            blob.sigma = sqrt(sigmas[d] * sigmas[d+1]);
+            blob.response = v;
+            candidates[b].push_back(blob);
+          }
+        }
+      }
+    }
+  });
+
+  // Gather and sort the blobs
+  for (int b = 0; b < nbands; b++) blobs.insert(blobs.end(), candidates[b].begin(), candidates[b].end());
+  std::sort(blobs.begin(), blobs.end(), StrongerBlob);
+
+  // Return number of blobs
+  return (int) blobs.size();
+}
@@ -0,0 +1,115 @@
+// Include file for Gaussian scale space class
+#ifndef R2_SCALE_SPACE_INCLUDED
+#define R2_SCALE_SPACE_INCLUDED
+
+
+
+// Include files
+
+#include <vector>
+
+
+
+// Constant definitions
+
+#define R2_SCALE_SPACE_SIGMA 1.6
+#define R2_SCALE_SPACE_LEVELS 6
+#define R2_SCALE_SPACE_FACTOR 1.4142135623730951
+#define R2_SCALE_SPACE_BLOB_THRESHOLD 0.03
+
+
+
+// Class definition
+
+struct R2Blob {
+  // Center, scale (the radius of a disk is about sigma * sqrt(2)), and
+  // normalized Laplacian response (negative for bright blobs, positive for dark)
+  R2Point position;
+  double sigma;
+  double response;
+};
+
+class R2ScaleSpace {
+ public:
+  // Constructor (blurs a width by height plane laid out like image pixels,
+  // plane[x*height + y], at nlevels scales sigma, sigma*factor, sigma*factor^2...;
+  // each level is blurred from the one below, so no blur is ever repeated)
+  R2ScaleSpace(const float *plane, int width, int height, double sigma = R2_SCALE_SPACE_SIGMA,
+    int nlevels = R2_SCALE_SPACE_LEVELS, double factor = R2_SCALE_SPACE_FACTOR);
+
+  // Scale space properties
+  int Width(void) const;
+  int Height(void) const;
+  int NLevels(void) const;
+  double Sigma(int level) const;
+  const float *Level(int level) const;
+
+  // Computes the difference of Gaussians between a level and the next one,
+  // scaled to approximate the scale-normalized Laplacian sigma^2 LoG at the level
+  void DifferenceOfGaussians(int level, float *dog) const;
+
+  // Detects blobs at all scales, as the extrema of the differences of Gaussians
+  // among their 26 neighbors in position and scale with a magnitude above
+  // threshold; returns the number of blobs, sorted from strongest to weakest
+  int DetectBlobs(std::vector<R2Blob>& blobs, double threshold = R2_SCALE_SPACE_BLOB_THRESHOLD) const;
+
+ private:
+  std::vector< std::vector<float> > levels;
+  std::vector<double> sigmas;
+  double factor;
+  int width;
+  int height;
+};
+
+
+
+// Inline functions
+
+inline int R2ScaleSpace::
+Width(void) const
+{
+  // Return width of the levels
+  return width;
+}
+
+
+
+inline int R2ScaleSpace::
+Height(void) const
+{
+  // Return height of the levels
+  return height;
+}
+
+
+
+inline int R2ScaleSpace::
+NLevels(void) const
+{
+  // Return number of levels
+  return (int) levels.size();
+}
+
+
+
+inline double R2ScaleSpace::
+Sigma(int level) const
+{
+  // Return standard deviation of the blur of a level
+  assert((level >= 0) && (level < NLevels()));
+  return sigmas[level];
+}
+
+
+
+inline const float *R2ScaleSpace::
+Level(int level) const
+{
+  // Return blurred plane of a level
+  assert((level >= 0) && (level < NLevels()));
+  return levels[level].data();
+}
+
+
+
+#endif
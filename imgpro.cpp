@@ -27,6 +27,8 @@
 #include "R2/R2.h"
 #include "R2Pixel.h"
 #include "R2Image.h"
+#include "R2ImagePyramid.h"
+#include "R2PixelOperations.h"
 
 
 
@@ -43,6 +45,9 @@ static char options[] =
 "  -brightness <real:factor>\n"
 "  -blur <real:sigma>\n"
 "  -sharpen \n"
+"  -point\n"
+"  -bilinear\n"
+"  -gaussian\n"
 "  -matchTranslation <file:other_image>\n"
 "  -matchHomography <file:other_image>\n"
 "  -processVid <int:num_frames>\n"
@@ -73,6 +78,16 @@ CheckOption(char *option, int argc, int minargc)
 
 
 
+static void 
+ApplyOperations(R2Image *image, R2PixelOperations& operations)
+{
+  // Apply the recorded per-pixel operations in one pass, and forget them
+  operations.Apply(*image);
+  operations.Clear();
+}
+
+
+
 static int 
 ReadCorrespondences(char *filename, R2Segment *&source_segments, R2Segment *&target_segments, int& nsegments)
 {
@@ -165,52 +180,78 @@ main(int argc, char **argv)
   // Initialize sampling method
   int sampling_method = R2_IMAGE_POINT_SAMPLING;
 
+  // Per-pixel operations are recorded, then applied together in a single pass
+  // over the image: the first pass of the next filter, or a pass of their own
+  // before any other operation and before the output image is written
+  R2PixelOperations operations;
+
   // Parse arguments and perform operations 
   while (argc > 0) {
     if (!strcmp(*argv, "-brightness")) {
       CheckOption(*argv, argc, 2);
       double factor = atof(argv[1]);
       argv += 2, argc -=2;
-      image->Brighten(factor);
+      operations.Scale(factor);
+      operations.Clamp();
     }
 	else if (!strcmp(*argv, "-sobelX")) {
       argv++, argc--;
-      image->SobelX();
+      image->SobelX(&operations);
+      operations.Clear();
     }
 	else if (!strcmp(*argv, "-sobelY")) {
       argv++, argc--;
-      image->SobelY();
+      image->SobelY(&operations);
+      operations.Clear();
     }
 	else if (!strcmp(*argv, "-log")) {
       argv++, argc--;
-      image->LoG();
+      image->LoG(R2_IMAGE_LOG_SIGMA, R2_IMAGE_EXACT_LOG, &operations);
+      operations.Clear();
     }
     else if (!strcmp(*argv, "-saturation")) {
       CheckOption(*argv, argc, 2);
       double factor = atof(argv[1]);
       argv += 2, argc -= 2;
-      image->ChangeSaturation(factor);
+      operations.Saturate(factor);
+      operations.Clamp();
     }
 	else if (!strcmp(*argv, "-harris")) {
       CheckOption(*argv, argc, 2);
       double sigma = atof(argv[1]);
       argv += 2, argc -= 2;
+      ApplyOperations(image, operations);
       image->Harris(sigma);
     }
     else if (!strcmp(*argv, "-blur")) {
       CheckOption(*argv, argc, 2);
       double sigma = atof(argv[1]);
       argv += 2, argc -= 2;
-      image->Blur(sigma);
+      image->Blur(sigma, R2_IMAGE_AUTOMATIC_BLUR, &operations);
+      operations.Clear();
     }
     else if (!strcmp(*argv, "-sharpen")) {
       argv++, argc--;
-      image->Sharpen();
+      image->Sharpen(R2_IMAGE_SHARPEN_AMOUNT, R2_IMAGE_SHARPEN_RADIUS, R2_IMAGE_SHARPEN_THRESHOLD, &operations);
+      operations.Clear();
+    }
+    else if (!strcmp(*argv, "-point")) {
+      sampling_method = R2_IMAGE_POINT_SAMPLING;
+      argv++, argc--;
+    }
+    else if (!strcmp(*argv, "-bilinear")) {
+      sampling_method = R2_IMAGE_BILINEAR_SAMPLING;
+      argv++, argc--;
+    }
+    else if (!strcmp(*argv, "-gaussian")) {
+      sampling_method = R2_IMAGE_GAUSSIAN_SAMPLING;
+      argv++, argc--;
     }
     else if (!strcmp(*argv, "-matchTranslation")) {
       CheckOption(*argv, argc, 2);
       R2Image *other_image = new R2Image(argv[1]);
       argv += 2, argc -= 2;
+      ApplyOperations(image, operations);
       image->blendOtherImageTranslated(other_image);
       delete other_image;
     }
@@ -218,6 +259,7 @@ main(int argc, char **argv)
       CheckOption(*argv, argc, 2);
       R2Image *other_image = new R2Image(argv[1]);
       argv += 2, argc -= 2;
+      ApplyOperations(image, operations);
       image->blendOtherImageHomography(other_image);
       delete other_image;
     }
@@ -225,10 +267,12 @@ main(int argc, char **argv)
       CheckOption(*argv, argc, 2);
       int num_frames = atof(argv[1]);
       argv += 2, argc -= 2;
+      ApplyOperations(image, operations);
       int start_tracking = 0; // set the frame number when we begin tracking the frame
       R2Image *image_frame;
-      Point origCorners[4];
-      Point currCorners[4];
+      R2ImagePyramid *freeze_pyramid = NULL;
+      R2Point origCorners[4];
+      R2Point currCorners[4];
       for (int i = 0; i < num_frames; i++) {
         char inputname[100], outname[100];;
         sprintf(inputname, "%s/%07d.jpg", input_folder_name, i+1);
@@ -239,18 +283,21 @@ main(int argc, char **argv)
           // capture the frame we need to freeze
           image->Read(inputname);
           image->detectFrameCorners(origCorners);
+          delete freeze_pyramid;
+          freeze_pyramid = new R2ImagePyramid(*image);
 
           for (int j = 0; j < 4; j++) {
             currCorners[j] = origCorners[j];
           }
         } else if (i > start_tracking) {
           // find frame and replace inside of frame with frozen image (must deal with different angle of frame)
-          image_frame->mapFramePixels(image, origCorners, currCorners);
+          image_frame->mapFramePixels(freeze_pyramid, origCorners, currCorners, sampling_method);
         }
         fprintf(stderr,"Made it through, %d",i);
         image_frame->Write(outname);
         delete image_frame;
       }
+      delete freeze_pyramid;
     }
     else if (!strcmp(*argv, "-multipleFreezes")) {
       CheckOption(*argv, argc, 2);
@@ -268,13 +315,15 @@ main(int argc, char **argv)
       int end2 = 260;
       int start3 = 302;
 
+      ApplyOperations(image, operations);
       R2Image *image2 = new R2Image();
       R2Image *image3 = new R2Image();
+      R2ImagePyramid *pyramid1 = NULL, *pyramid2 = NULL, *pyramid3 = NULL;
 
       argv += 3, argc -= 3;
       R2Image *image_frame;
-      Point origCorners[4];
-      Point currCorners[4];
+      R2Point origCorners[4];
+      R2Point currCorners[4];
 
       for (int i = 0; i < num_frames; i++) {
         char inputname[100], outname[100];;
@@ -286,7 +335,7 @@ main(int argc, char **argv)
           // capture the frame we need to freeze
           image->Read(inputname);
           image->detectFrameCorners(origCorners);
-
+          pyramid1 = new R2ImagePyramid(*image);
 
           for (int j = 0; j < 4; j++) {
             currCorners[j] = origCorners[j];
@@ -295,9 +344,11 @@ main(int argc, char **argv)
           if (i == start2) {
             image2->Read(inputname);
             image2->detectFrameCorners(origCorners);
+            pyramid2 = new R2ImagePyramid(*image2);
           } else {
             image3->Read(inputname);
             image3->detectFrameCorners(origCorners);
+            pyramid3 = new R2ImagePyramid(*image3);
           }
           for (int j = 0; j < 4; j++) {
             currCorners[j] = origCorners[j];
@@ -307,14 +358,14 @@ main(int argc, char **argv)
         } else if (i > start1 && i <= end1) {
           fprintf(stderr,"replacing frame1 on image %d   ",i);
           // find frame and replace inside of frame with frozen image (must deal with different angle of frame)
-          image_frame->mapFramePixels(image, origCorners, currCorners);
+          image_frame->mapFramePixels(pyramid1, origCorners, currCorners, sampling_method);
           //return 1;
         } else if (i > start2 && i <= end2) {
           fprintf(stderr,"replacing frame2 on image %d   ",i);
-          image_frame->mapFramePixels(image2, origCorners, currCorners);
+          image_frame->mapFramePixels(pyramid2, origCorners, currCorners, sampling_method);
         } else if (i > start3) {
           fprintf(stderr,"replacing frame3 on image %d   ",i);
-          image_frame->mapFramePixels(image3, origCorners, currCorners);
+          image_frame->mapFramePixels(pyramid3, origCorners, currCorners, sampling_method);
         }
         //if (i%10 == 0) {
           fprintf(stderr,"Made it through %d\n",i);
@@ -322,6 +373,11 @@ main(int argc, char **argv)
         image_frame->Write(outname);
         delete image_frame;
       }
+      delete pyramid1;
+      delete pyramid2;
+      delete pyramid3;
+      delete image2;
+      delete image3;
     }
     else {
       // Unrecognized program argument
@@ -330,6 +386,9 @@ main(int argc, char **argv)
     }
   }
 
+  // Apply the per-pixel operations still recorded
+  ApplyOperations(image, operations);
+
   // Write output image
   /*if (!image->Write(output_image_name)) {
     fprintf(stderr, "Unable to read image from %s\n", output_image_name);
@@ -6,16 +6,17 @@ and B.P. Flannery
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <vector>
+#include "R2Parallel.h"
+#include "svd.h"
 
 #define NR_END 1
 #define FREE_ARG char*
 #define SIGN(a,b) ((b) >= 0.0 ? fabs(a) : -fabs(a))
-static double dmaxarg1,dmaxarg2;
-#define DMAX(a,b) (dmaxarg1=(a),dmaxarg2=(b),(dmaxarg1) > (dmaxarg2) ?\
-(dmaxarg1) : (dmaxarg2))
-static int iminarg1,iminarg2;
-#define IMIN(a,b) (iminarg1=(a),iminarg2=(b),(iminarg1) < (iminarg2) ?\
-(iminarg1) : (iminarg2))
+/* max/min without the file-scope temporaries of the original macros, so that
+   svdcmp can run on several threads at once */
+static inline double DMAX(double a, double b) { return a > b ? a : b; }
+static inline int IMIN(int a, int b) { return a < b ? a : b; }
 
 double **dmatrix(int nrl, int nrh, int ncl, int nch)
 /* allocate a double matrix with subscript range m[nrl..nrh][ncl..nch] */
@@ -68,10 +69,24 @@ matrix of singular values W is output as a vector w[1..n].  The matrix V (not
 the transpose VT) is output as v[1..n][1..n].
 *******************************************************************************/
 {
-	int flag,i,its,j,jj,k,l,nm;
-	double anorm,c,f,g,h,s,scale,x,y,z,*rv1;
+	double *rv1;
 
 	rv1=dvector(1,n);
+	svdcmp_r(a,m,n,w,v,rv1);
+	free_dvector(rv1,1,n);
+}
+
+/******************************************************************************/
+void svdcmp_r(double **a, int m, int n, double w[], double **v, double rv1[])
+/*******************************************************************************
+Reentrant svdcmp: same arguments and results, but the scratch vector is passed
+in by the caller as rv1[1..n] (n+1 doubles), so the routine allocates nothing
+and keeps no state between calls.
+*******************************************************************************/
+{
+	int flag,i,its,j,jj,k,l,nm=0;
+	double anorm,c,f,g,h,s,scale,x,y,z;
+
 	g=scale=anorm=0.0; /* Householder reduction to bidiagonal form */
 	for (i=1;i<=n;i++) {
 		l=i+1;
@@ -241,5 +256,19 @@ the transpose VT) is output as v[1..n][1..n].
 			w[k]=x;
 		}
 	}
-	free_dvector(rv1,1,n);
+}
+
+/******************************************************************************/
+void svdcmp_batch(double ***a, int count, int m, int n, double **w, double ***v)
+/*******************************************************************************
+Decomposes count matrices a[0..count-1][1..m][1..n] of the same size in one
+call, with the results in w[0..count-1][1..n] and v[0..count-1][1..n][1..n].
+The matrices are split across the worker threads, each of which uses a single
+scratch vector for all of its matrices.
+*******************************************************************************/
+{
+	R2ParallelFor(0,count,R2NumThreads(),[&](int begin, int end) {
+		std::vector<double> rv1(n+1);
+		for (int b=begin;b<end;b++) svdcmp_r(a[b],m,n,w[b],v[b],&rv1[0]);
+	});
 }
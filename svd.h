@@ -3,4 +3,6 @@
 double **dmatrix(int nrl, int nrh, int ncl, int nch);
 double *dvector(int nl, int nh);
 void free_dvector(double *v, int nl, int nh);
-void svdcmp(double **a, int m, int n, double w[], double **v);
\ No newline at end of file
+void svdcmp(double **a, int m, int n, double w[], double **v);
+void svdcmp_r(double **a, int m, int n, double w[], double **v, double rv1[]);
+void svdcmp_batch(double ***a, int count, int m, int n, double **w, double ***v);
\ No newline at end of file